@@ -0,0 +1,336 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Fixed-capacity LRU cache. Entries sit in a hash map guarded by a
+// shared_mutex, and also on an intrusive doubly linked recency list guarded
+// by its own mutex, so a touch or an eviction is O(1). A get only takes the
+// map lock in shared mode. It records the touch in one of several striped
+// buffers instead of relinking the entry at once. A buffer is applied to the
+// recency list once it holds batch_size touches, if the list lock is free.
+// Writers apply every buffer before choosing a victim. Readers therefore
+// rarely meet on the list lock, and eviction still sees every access.
+// Buffers are replayed one stripe at a time, though, so touches from
+// different threads may be applied out of order; the order is only
+// approximately LRU. Stamping each touch from a shared counter would make
+// it exact, but that counter would be one more line every get writes.
+template<typename Key, typename Value, typename Hash = std::hash<Key> >
+class concurrent_lru_cache {
+private:
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t num_stripes = 16;
+    static constexpr std::size_t batch_size = 32;
+
+    struct link {
+        link* prev = nullptr;
+        link* next = nullptr;
+    };
+
+    struct entry : link {
+        Key const key;
+        Value value;
+
+        entry(Key const& key_, Value const& value_) : key(key_), value(value_) {}
+    };
+
+    struct alignas(cache_line_size) touch_buffer {
+        std::mutex m;
+        std::vector<entry*> touches;
+    };
+
+    std::size_t const capacity;
+
+    mutable std::shared_mutex map_mutex;
+    std::unordered_map<Key, std::unique_ptr<entry>, Hash> entries;
+
+    // Circular list through a sentinel; sentinel.next is the most recent.
+    // Lock order: map_mutex, then a stripe's mutex, then lru_mutex.
+    std::mutex lru_mutex;
+    link sentinel;
+
+    touch_buffer stripes[num_stripes];
+
+    touch_buffer& local_stripe() {
+        thread_local std::size_t const index = std::hash<std::thread::id>()(std::this_thread::get_id()) % num_stripes;
+        return stripes[index];
+    }
+
+    // Both need lru_mutex.
+    static void unlink(link* e) {
+        e->prev->next = e->next;
+        e->next->prev = e->prev;
+    }
+
+    void link_front(link* e) {
+        e->prev = &sentinel;
+        e->next = sentinel.next;
+        sentinel.next->prev = e;
+        sentinel.next = e;
+    }
+
+    // Needs lru_mutex, and the stripe's mutex unless map_mutex is held
+    // exclusively.
+    void apply(touch_buffer& stripe) {
+        for (entry* e : stripe.touches) {
+            unlink(e);
+            link_front(e);
+        }
+        stripe.touches.clear();
+    }
+
+    // Needs map_mutex held exclusively. Buffers are only changed under the
+    // shared map lock, so they are quiescent here and need no stripe lock, and
+    // no buffered pointer can outlive its entry after this returns. Each
+    // stripe keeps its own order, but stripes are applied one after another.
+    // An entry touched recently in an early stripe can therefore end up
+    // behind one touched earlier in a later stripe.
+    void apply_all() {
+        std::lock_guard<std::mutex> lru_lock(lru_mutex);
+        for (touch_buffer& stripe : stripes)
+            apply(stripe);
+    }
+
+    void record_touch(entry* e) {
+        touch_buffer& stripe = local_stripe();
+        std::lock_guard<std::mutex> stripe_lock(stripe.m);
+        stripe.touches.push_back(e);
+        if (stripe.touches.size() < batch_size)
+            return;
+        std::unique_lock<std::mutex> lru_lock(lru_mutex, std::try_to_lock);
+        if (lru_lock.owns_lock())
+            apply(stripe);
+    }
+
+public:
+    explicit concurrent_lru_cache(std::size_t capacity_, Hash const& hasher = Hash())
+        : capacity(capacity_), entries(0, hasher) {
+        if (capacity == 0)
+            throw std::invalid_argument("concurrent_lru_cache capacity must be positive");
+        entries.reserve(capacity);
+        sentinel.prev = &sentinel;
+        sentinel.next = &sentinel;
+        for (touch_buffer& stripe : stripes)
+            stripe.touches.reserve(batch_size * 2);
+    }
+
+    concurrent_lru_cache(concurrent_lru_cache const& other) = delete;
+    concurrent_lru_cache& operator=(concurrent_lru_cache const& other) = delete;
+
+    // Returns a copy of the value and marks the entry as recently used.
+    std::optional<Value> get(Key const& key) {
+        std::shared_lock<std::shared_mutex> lock(map_mutex);
+        auto const found = entries.find(key);
+        if (found == entries.end())
+            return std::nullopt;
+        entry* const e = found->second.get();
+        record_touch(e);
+        return e->value;
+    }
+
+    // Inserts or replaces the value for key and makes it the most recent
+    // entry, evicting the least recently used entry if the cache is full.
+    void put(Key const& key, Value const& value) {
+        std::unique_lock<std::shared_mutex> lock(map_mutex);
+        auto const found = entries.find(key);
+        if (found != entries.end()) {
+            entry* const e = found->second.get();
+            e->value = value;
+            std::lock_guard<std::mutex> lru_lock(lru_mutex);
+            unlink(e);
+            link_front(e);
+            return;
+        }
+
+        std::unique_ptr<entry> new_entry(new entry(key, value));
+        if (entries.size() == capacity) {
+            // Pending touches predate this put, so they go in first.
+            apply_all();
+            entry* victim;
+            {
+                std::lock_guard<std::mutex> lru_lock(lru_mutex);
+                victim = static_cast<entry*>(sentinel.prev);
+                unlink(victim);
+            }
+            entries.erase(victim->key);
+        }
+
+        entry* const e = new_entry.get();
+        entries.emplace(key, std::move(new_entry));
+        std::lock_guard<std::mutex> lru_lock(lru_mutex);
+        link_front(e);
+    }
+
+    bool erase(Key const& key) {
+        std::unique_lock<std::shared_mutex> lock(map_mutex);
+        auto const found = entries.find(key);
+        if (found == entries.end())
+            return false;
+        apply_all();
+        {
+            std::lock_guard<std::mutex> lru_lock(lru_mutex);
+            unlink(found->second.get());
+        }
+        entries.erase(found);
+        return true;
+    }
+
+    std::size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(map_mutex);
+        return entries.size();
+    }
+
+    // Keys from most to least recently used, with every pending touch
+    // applied first.
+    std::vector<Key> keys_by_recency() {
+        std::unique_lock<std::shared_mutex> lock(map_mutex);
+        apply_all();
+        std::vector<Key> keys;
+        std::lock_guard<std::mutex> lru_lock(lru_mutex);
+        for (link* e = sentinel.next; e != &sentinel; e = e->next)
+            keys.push_back(static_cast<entry*>(e)->key);
+        return keys;
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    concurrent_lru_cache<std::string, int> cache(3);
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("c", 3);
+
+    // The buffered touch of "a" is applied before the eviction, so "b" goes
+    std::optional<int> a = cache.get("a");
+    assert(a && *a == 1);
+    cache.put("d", 4);
+    assert(cache.size() == 3);
+    assert(!cache.get("b"));
+    assert((cache.keys_by_recency() == std::vector<std::string>{"d", "a", "c"}));
+
+    // Updating an entry refreshes it
+    cache.put("c", 30);
+    cache.put("e", 5);
+    assert((cache.keys_by_recency() == std::vector<std::string>{"e", "c", "d"}));
+    std::optional<int> c = cache.get("c");
+    assert(c && *c == 30);
+
+    bool const erased = cache.erase("d");
+    assert(erased);
+    bool const erased_again = cache.erase("d");
+    assert(!erased_again);
+    assert(cache.size() == 2);
+
+    bool thrown = false;
+    try {
+        concurrent_lru_cache<int, int> empty(0);
+    } catch (std::invalid_argument const&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_concurrent_operations() {
+    concurrent_lru_cache<int, int> cache(256);
+    const int num_threads = 4;
+    const int ops_per_thread = 20000;
+    const int key_range = 1024;
+    std::vector<std::thread> threads;
+    std::atomic<bool> values_ok(true);
+
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::minstd_rand generator(t);
+            for (int i = 0; i < ops_per_thread; ++i) {
+                int const key = static_cast<int>(generator() % key_range);
+                switch (generator() % 8) {
+                case 0:
+                    cache.put(key, key * 2);
+                    break;
+                case 1:
+                    cache.erase(key);
+                    break;
+                default: {
+                    std::optional<int> value = cache.get(key);
+                    if (value && *value != key * 2) {
+                        values_ok = false;
+                    }
+                }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    assert(values_ok);
+    assert(cache.size() <= 256);
+
+    std::vector<int> keys = cache.keys_by_recency();
+    assert(keys.size() == cache.size());
+    for (int key : keys) {
+        std::optional<int> value = cache.get(key);
+        assert(value && *value == key * 2);
+    }
+}
+
+// benchmarking
+
+// Mixed get/put traffic on a skewed key set; reports throughput and hit rate.
+void benchmark_mixed(int num_threads, int ops_per_thread) {
+    concurrent_lru_cache<int, int> cache(10000);
+    std::atomic<long> hits(0);
+    std::vector<std::thread> threads;
+
+    auto const start = std::chrono::steady_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::minstd_rand generator(t);
+            // Squaring a uniform value skews lookups towards small keys
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            long local_hits = 0;
+            for (int i = 0; i < ops_per_thread; ++i) {
+                double const u = uniform(generator);
+                int const key = static_cast<int>(u * u * 100000);
+                if (cache.get(key)) {
+                    ++local_hits;
+                } else {
+                    cache.put(key, key);
+                }
+            }
+            hits += local_hits;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long const total = static_cast<long>(num_threads) * ops_per_thread;
+    std::cout << num_threads << " threads: " << seconds * 1e9 / total << " ns/op, hit rate "
+              << 100.0 * hits / total << "%" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    int const ops = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    for (int threads : {1, 2, 4, 8}) {
+        benchmark_mixed(threads, ops / threads);
+    }
+    return 0;
+}
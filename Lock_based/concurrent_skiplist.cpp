@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../Lock_free/epoch_reclamation.h"
+
+#define THREADSAFE_LIST_NO_TESTS
+#include "threadsafe_list.cpp"
+
+// Value type of a skiplist used as a set.
+struct skiplist_no_value {};
+
+// Ordered map built as a lazy skiplist (Herlihy, Lev, Luchangco, Shavit).
+// It applies the lazy_list scheme to every level. find, contains,
+// lower_bound and range iteration walk the towers without locking. insert
+// and erase lock only the predecessors of the tower they change, then
+// validate them. A node counts as present once it is fully linked and until
+// it is marked. Unlinked towers are freed through epoch_domain.
+// Keys are unique; values are immutable once inserted.
+template<typename Key, typename Value = skiplist_no_value, typename Compare = std::less<Key> >
+class concurrent_skiplist {
+private:
+    static constexpr int max_level = 24;
+
+    // The top_level + 1 forward links are allocated right behind the node,
+    // so a hop costs one cache miss rather than two.
+    struct node {
+        Key const key;
+        Value const value;
+        int const top_level;
+        std::atomic<bool> marked;
+        std::atomic<bool> fully_linked;
+        std::mutex m;
+
+        node(Key const& key_, Value const& value_, int top_level_)
+            : key(key_), value(value_), top_level(top_level_), marked(false), fully_linked(false) {}
+
+        std::atomic<node*>* next() {
+            return reinterpret_cast<std::atomic<node*>*>(this + 1);
+        }
+
+        static node* create(Key const& key, Value const& value, int top_level) {
+            void* const memory = ::operator new(sizeof(node) + (top_level + 1) * sizeof(std::atomic<node*>));
+            node* n;
+            try {
+                n = new (memory) node(key, value, top_level);
+            } catch (...) {
+                ::operator delete(memory);
+                throw;
+            }
+            for (int level = 0; level <= top_level; ++level)
+                new (&n->next()[level]) std::atomic<node*>(nullptr);
+            return n;
+        }
+
+        static void destroy(void* p) {
+            node* const n = static_cast<node*>(p);
+            n->~node();
+            ::operator delete(p);
+        }
+    };
+    static_assert(sizeof(node) % alignof(std::atomic<node*>) == 0, "links must follow the node aligned");
+
+    // The head tower; its key and value are never read.
+    struct head_node {
+        std::atomic<node*> next[max_level];
+        std::mutex m;
+
+        head_node() {
+            for (int level = 0; level < max_level; ++level)
+                next[level].store(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    // A predecessor is either the head or a node. Both expose next[] and m.
+    struct position {
+        std::atomic<node*>* links[max_level];
+        std::mutex* locks[max_level];
+        std::atomic<bool> const* pred_marked[max_level];
+        node* succs[max_level];
+    };
+
+    head_node head;
+    Compare less;
+
+    // Geometric level with p = 1/2, drawn from a per-thread generator.
+    static int random_level() {
+        thread_local std::minstd_rand generator(std::random_device{}());
+        std::uint32_t bits = static_cast<std::uint32_t>(generator()) | (1u << (max_level - 1));
+        int level = 0;
+        while ((bits & 1) == 0) {
+            ++level;
+            bits >>= 1;
+        }
+        return std::min(level, max_level - 1);
+    }
+
+    // Fills pos with the predecessor and successor of key at every level and
+    // returns the highest level at which a node with key was seen, or -1.
+    // The caller must hold an epoch_guard.
+    int locate(Key const& key, position& pos) {
+        int found_level = -1;
+        std::atomic<node*>* links = head.next;
+        std::mutex* lock = &head.m;
+        std::atomic<bool> const* marked = nullptr;
+        for (int level = max_level - 1; level >= 0; --level) {
+            node* curr = links[level].load();
+            while (curr && less(curr->key, key)) {
+                links = curr->next();
+                lock = &curr->m;
+                marked = &curr->marked;
+                curr = links[level].load();
+            }
+            if (found_level == -1 && curr && !less(key, curr->key))
+                found_level = level;
+            pos.links[level] = &links[level];
+            pos.locks[level] = lock;
+            pos.pred_marked[level] = marked;
+            pos.succs[level] = curr;
+        }
+        return found_level;
+    }
+
+    // First node with key not less than key that is present, or null.
+    node* first_not_less(Key const& key) {
+        std::atomic<node*>* links = head.next;
+        node* curr = nullptr;
+        for (int level = max_level - 1; level >= 0; --level) {
+            curr = links[level].load();
+            while (curr && less(curr->key, key)) {
+                links = curr->next();
+                curr = links[level].load();
+            }
+        }
+        while (curr && (curr->marked.load() || !curr->fully_linked.load()))
+            curr = curr->next()[0].load();
+        return curr;
+    }
+
+    // Locks the distinct predecessors from level 0 up to top_level (that is,
+    // from the highest key down, which every writer does in the same order)
+    // and checks that each still links to its expected successor.
+    bool lock_and_validate(position const& pos, int top_level, node* expected_succ,
+                           std::unique_lock<std::mutex> (&locks)[max_level]) {
+        std::mutex* previous = nullptr;
+        for (int level = 0; level <= top_level; ++level) {
+            if (pos.locks[level] != previous) {
+                locks[level] = std::unique_lock<std::mutex>(*pos.locks[level]);
+                previous = pos.locks[level];
+            }
+            node* const succ = expected_succ ? expected_succ : pos.succs[level];
+            bool const pred_ok = !pos.pred_marked[level] || !pos.pred_marked[level]->load();
+            bool const succ_ok = expected_succ || !succ || !succ->marked.load();
+            if (!pred_ok || !succ_ok || pos.links[level]->load() != succ)
+                return false;
+        }
+        return true;
+    }
+
+public:
+    concurrent_skiplist() {}
+
+    ~concurrent_skiplist() {
+        node* current = head.next[0].load();
+        while (current) {
+            node* const next = current->next()[0].load();
+            node::destroy(current);
+            current = next;
+        }
+    }
+
+    concurrent_skiplist(concurrent_skiplist const& other) = delete;
+    concurrent_skiplist& operator=(concurrent_skiplist const& other) = delete;
+
+    bool insert(Key const& key, Value const& value = Value()) {
+        int const top_level = random_level();
+        epoch_guard guard;
+        position pos;
+        for (;;) {
+            int const found_level = locate(key, pos);
+            if (found_level != -1) {
+                node* const found = pos.succs[found_level];
+                if (!found->marked.load()) {
+                    // Wait for a concurrent insert of the same key to finish.
+                    while (!found->fully_linked.load())
+                        std::this_thread::yield();
+                    return false;
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> locks[max_level];
+            if (!lock_and_validate(pos, top_level, nullptr, locks))
+                continue;
+
+            node* const new_node = node::create(key, value, top_level);
+            for (int level = 0; level <= top_level; ++level)
+                new_node->next()[level].store(pos.succs[level], std::memory_order_relaxed);
+            for (int level = 0; level <= top_level; ++level)
+                pos.links[level]->store(new_node);
+            new_node->fully_linked.store(true);
+            return true;
+        }
+    }
+
+    bool erase(Key const& key) {
+        epoch_guard guard;
+        position pos;
+        node* victim = nullptr;
+        std::unique_lock<std::mutex> victim_lock;
+        for (;;) {
+            int const found_level = locate(key, pos);
+            if (!victim) {
+                if (found_level == -1)
+                    return false;
+                node* const candidate = pos.succs[found_level];
+                // Only a fully linked node seen at its top level may be erased.
+                if (!candidate->fully_linked.load() || candidate->top_level != found_level ||
+                    candidate->marked.load())
+                    return false;
+                victim_lock = std::unique_lock<std::mutex>(candidate->m);
+                if (candidate->marked.load())
+                    return false;
+                candidate->marked.store(true);
+                victim = candidate;
+            }
+
+            std::unique_lock<std::mutex> locks[max_level];
+            if (!lock_and_validate(pos, victim->top_level, victim, locks))
+                continue;
+
+            for (int level = victim->top_level; level >= 0; --level)
+                pos.links[level]->store(victim->next()[level].load());
+            break;
+        }
+        victim_lock.unlock();
+        epoch_domain::instance().retire(victim, &node::destroy);
+        return true;
+    }
+
+    bool contains(Key const& key) {
+        epoch_guard guard;
+        node* const curr = first_not_less(key);
+        return curr && !less(key, curr->key);
+    }
+
+    std::optional<Value> find(Key const& key) {
+        epoch_guard guard;
+        node* const curr = first_not_less(key);
+        if (curr && !less(key, curr->key))
+            return curr->value;
+        return std::nullopt;
+    }
+
+    // Smallest entry whose key is not less than key.
+    std::optional<std::pair<Key, Value> > lower_bound(Key const& key) {
+        epoch_guard guard;
+        if (node* const curr = first_not_less(key))
+            return std::make_pair(curr->key, curr->value);
+        return std::nullopt;
+    }
+
+    // Calls f(key, value) in key order for every entry with first <= key <
+    // last. Like lazy_list::for_each this is not a snapshot: entries
+    // inserted or erased during the walk may or may not be seen.
+    template<typename Function>
+    void for_each_range(Key const& first, Key const& last, Function f) {
+        epoch_guard guard;
+        for (node* curr = first_not_less(first); curr && less(curr->key, last);
+             curr = curr->next()[0].load()) {
+            if (!curr->marked.load() && curr->fully_linked.load())
+                f(curr->key, curr->value);
+        }
+    }
+
+    template<typename Function>
+    void for_each(Function f) {
+        epoch_guard guard;
+        for (node* curr = head.next[0].load(); curr; curr = curr->next()[0].load()) {
+            if (!curr->marked.load() && curr->fully_linked.load())
+                f(curr->key, curr->value);
+        }
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    concurrent_skiplist<int, std::string> map;
+    for (int k : {50, 10, 40, 20, 30}) {
+        bool const inserted = map.insert(k, std::to_string(k));
+        assert(inserted);
+    }
+    bool const duplicate = map.insert(30, "again");
+    assert(!duplicate);
+
+    std::optional<std::string> value = map.find(30);
+    assert(value && *value == "30");
+    assert(!map.find(35));
+
+    auto bound = map.lower_bound(31);
+    assert(bound && bound->first == 40 && bound->second == "40");
+    assert(!map.lower_bound(51));
+
+    std::vector<int> keys;
+    map.for_each_range(20, 50, [&](int const& k, std::string const&) { keys.push_back(k); });
+    assert((keys == std::vector<int>{20, 30, 40}));
+
+    bool const erased = map.erase(40);
+    assert(erased);
+    bool const erased_again = map.erase(40);
+    assert(!erased_again);
+    assert(!map.contains(40));
+    bound = map.lower_bound(31);
+    assert(bound && bound->first == 50);
+
+    // Used as a set
+    concurrent_skiplist<int> set;
+    for (int k = 1000; k > 0; --k) {
+        set.insert(k);
+    }
+    int expected = 1;
+    set.for_each([&](int const& k, skiplist_no_value const&) { assert(k == expected++); });
+    assert(expected == 1001);
+}
+
+void test_concurrent_operations() {
+    concurrent_skiplist<int, int> map;
+    const int num_writers = 4;
+    const int range = 4000;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+
+    // Multiples of 4 stay in the map; writers churn the rest
+    for (int k = 0; k < range; k += 4) {
+        map.insert(k, -k);
+    }
+
+    for (int t = 0; t < num_writers; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 10; ++round) {
+                for (int k = t; k < range; k += num_writers) {
+                    if (k % 4 != 0) {
+                        map.insert(k, -k);
+                    }
+                }
+                for (int k = t; k < range; k += num_writers) {
+                    if (k % 4 != 0) {
+                        bool const erased = map.erase(k);
+                        assert(erased);
+                    }
+                }
+            }
+        });
+    }
+
+    bool readers_ok = true;
+    std::mutex readers_mutex;
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&] {
+            bool ok = true;
+            while (!done.load()) {
+                int previous = -1;
+                int stable = 0;
+                map.for_each_range(1000, 2000, [&](int const& k, int const& v) {
+                    ok = ok && k > previous && v == -k;
+                    previous = k;
+                    if (k % 4 == 0) {
+                        ++stable;
+                    }
+                });
+                ok = ok && stable == 250;
+                std::optional<int> value = map.find(2000);
+                ok = ok && value && *value == -2000;
+                auto bound = map.lower_bound(1997);
+                ok = ok && bound && bound->first >= 1997 && bound->first <= 2000;
+            }
+            std::lock_guard<std::mutex> lock(readers_mutex);
+            readers_ok = readers_ok && ok;
+        });
+    }
+
+    for (int t = 0; t < num_writers; ++t) {
+        threads[t].join();
+    }
+    done.store(true);
+    for (std::size_t t = num_writers; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    assert(readers_ok);
+
+    int count = 0;
+    map.for_each([&](int const& k, int const&) {
+        assert(k % 4 == 0);
+        ++count;
+    });
+    assert(count == range / 4);
+}
+
+// benchmarking
+
+// Point lookups and 100-key range scans over num_items sorted keys, against a
+// threadsafe_list kept in key order and scanned linearly.
+void benchmark_against_list(int num_items, int list_queries) {
+    std::vector<int> keys(num_items);
+    for (int i = 0; i < num_items; ++i) {
+        keys[i] = 2 * i;
+    }
+    std::mt19937 generator(42);
+    std::shuffle(keys.begin(), keys.end(), generator);
+    std::uniform_int_distribution<int> pick(0, 2 * num_items - 1);
+
+    auto elapsed_ns = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    concurrent_skiplist<int> map;
+    auto start = std::chrono::steady_clock::now();
+    for (int k : keys) {
+        map.insert(k);
+    }
+    double const skiplist_insert = elapsed_ns(start) / num_items;
+
+    const int skiplist_queries = 100000;
+    long hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < skiplist_queries; ++i) {
+        hits += map.lower_bound(pick(generator)) ? 1 : 0;
+    }
+    double const skiplist_lookup = elapsed_ns(start) / skiplist_queries;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < skiplist_queries; ++i) {
+        int const first = pick(generator);
+        map.for_each_range(first, first + 200, [&](int const&, skiplist_no_value const&) { ++hits; });
+    }
+    double const skiplist_range = elapsed_ns(start) / skiplist_queries;
+
+    // The list is built already sorted; inserting in order would need a scan each
+    threadsafe_list<int> list;
+    std::sort(keys.begin(), keys.end());
+    start = std::chrono::steady_clock::now();
+    for (int k : keys) {
+        list.push_back(k);
+    }
+    double const list_insert = elapsed_ns(start) / num_items;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < list_queries; ++i) {
+        int const key = pick(generator);
+        hits += list.find_first_if_visit([key](int const& v) { return v >= key; }, [](int const& v) { return v; }) ? 1 : 0;
+    }
+    double const list_lookup = elapsed_ns(start) / list_queries;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < list_queries; ++i) {
+        int const first = pick(generator);
+        // for_each has no early exit, so a range scan visits the whole list
+        list.for_each_shared([&](int const& v) {
+            if (v >= first && v < first + 200) {
+                ++hits;
+            }
+        });
+    }
+    double const list_range = elapsed_ns(start) / list_queries;
+
+    std::cout << num_items << " sorted keys (" << hits << " hits)" << std::endl;
+    std::cout << "  concurrent_skiplist: insert " << skiplist_insert << " ns, lower_bound "
+              << skiplist_lookup << " ns, 100-key range " << skiplist_range << " ns" << std::endl;
+    std::cout << "  threadsafe_list:     push_back " << list_insert << " ns (presorted), first >= key "
+              << list_lookup << " ns, 100-key range " << list_range << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    benchmark_against_list(argc > 1 ? std::atoi(argv[1]) : 1000000, argc > 2 ? std::atoi(argv[2]) : 20);
+    return 0;
+}
@@ -0,0 +1,343 @@
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Bounded queue living in a POSIX shared memory object, so a producer and a
+// consumer in different processes can exchange trivially copyable values
+// without a socket. The mapping holds only indices and raw slot bytes, never
+// pointers, so each process may map it at a different address. Blocking uses
+// process-shared futexes on words inside the mapping.
+template<typename T>
+class interprocess_queue {
+    static_assert(std::is_trivially_copyable<T>::value, "interprocess_queue needs a trivially copyable T");
+
+private:
+    static constexpr std::uint32_t magic_value = 0x49505131;
+
+    struct shared_header {
+        std::atomic<std::uint32_t> magic;
+        std::uint32_t element_size;
+        std::uint64_t capacity;
+
+        // 0 unlocked, 1 locked, 2 locked with waiters
+        std::atomic<std::uint32_t> lock_word;
+
+        // Event counters: bumped on every push / pop that a sleeper cares about.
+        std::atomic<std::uint32_t> not_empty_seq;
+        std::atomic<std::uint32_t> not_full_seq;
+        std::uint32_t pop_waiters;
+        std::uint32_t push_waiters;
+
+        // Monotonic counts, protected by lock_word.
+        std::uint64_t head;
+        std::uint64_t tail;
+    };
+
+    static std::size_t slots_offset() {
+        return (sizeof(shared_header) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    static std::size_t mapping_size(std::size_t capacity) {
+        return slots_offset() + capacity * sizeof(T);
+    }
+
+    static long futex(std::atomic<std::uint32_t>* word, int op, std::uint32_t value) {
+        return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), op, value, nullptr, nullptr, 0);
+    }
+
+    std::string name;
+    int fd;
+    std::size_t size;
+    void* base;
+    shared_header* header;
+
+    unsigned char* slot(std::uint64_t index) {
+        return static_cast<unsigned char*>(base) + slots_offset() + (index % header->capacity) * sizeof(T);
+    }
+
+    void lock() {
+        std::uint32_t c = 0;
+        if (header->lock_word.compare_exchange_strong(c, 1))
+            return;
+        if (c != 2)
+            c = header->lock_word.exchange(2);
+        while (c != 0) {
+            futex(&header->lock_word, FUTEX_WAIT, 2);
+            c = header->lock_word.exchange(2);
+        }
+    }
+
+    void unlock() {
+        if (header->lock_word.fetch_sub(1) != 1) {
+            header->lock_word.store(0);
+            futex(&header->lock_word, FUTEX_WAKE, 1);
+        }
+    }
+
+    // Called with the lock held; returns with the lock held.
+    void wait_on(std::atomic<std::uint32_t>& seq, std::uint32_t& waiters) {
+        std::uint32_t const seen = seq.load();
+        ++waiters;
+        unlock();
+        futex(&seq, FUTEX_WAIT, seen);
+        lock();
+        --waiters;
+    }
+
+    void signal(std::atomic<std::uint32_t>& seq, std::uint32_t waiters) {
+        if (waiters == 0)
+            return;
+        seq.fetch_add(1);
+        futex(&seq, FUTEX_WAKE, INT_MAX);
+    }
+
+    void push_locked(T const& value) {
+        std::memcpy(slot(header->tail), &value, sizeof(T));
+        ++header->tail;
+        signal(header->not_empty_seq, header->pop_waiters);
+    }
+
+    void pop_locked(T& value) {
+        std::memcpy(&value, slot(header->head), sizeof(T));
+        ++header->head;
+        signal(header->not_full_seq, header->push_waiters);
+    }
+
+    bool full_locked() const {
+        return header->tail - header->head == header->capacity;
+    }
+
+    bool empty_locked() const {
+        return header->tail == header->head;
+    }
+
+public:
+    // Creates the shared object, or attaches to it if another process
+    // already did; capacity is ignored when attaching.
+    interprocess_queue(std::string const& name_, std::size_t capacity) :
+        name(name_), fd(-1), size(0), base(MAP_FAILED), header(nullptr) {
+        bool created = true;
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            created = false;
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+        }
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+
+        if (created) {
+            if (capacity == 0) {
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::invalid_argument("interprocess_queue capacity must be positive");
+            }
+            size = mapping_size(capacity);
+            if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                int const err = errno;
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::system_error(err, std::generic_category(), "ftruncate");
+            }
+        } else {
+            // The creator may not have sized the object yet.
+            struct stat st;
+            do {
+                if (fstat(fd, &st) != 0) {
+                    int const err = errno;
+                    close(fd);
+                    throw std::system_error(err, std::generic_category(), "fstat");
+                }
+                if (st.st_size == 0)
+                    std::this_thread::yield();
+            } while (st.st_size == 0);
+            size = static_cast<std::size_t>(st.st_size);
+        }
+
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            int const err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "mmap");
+        }
+        header = static_cast<shared_header*>(base);
+
+        if (created) {
+            header->element_size = sizeof(T);
+            header->capacity = capacity;
+            header->lock_word.store(0);
+            header->not_empty_seq.store(0);
+            header->not_full_seq.store(0);
+            header->pop_waiters = 0;
+            header->push_waiters = 0;
+            header->head = 0;
+            header->tail = 0;
+            header->magic.store(magic_value);
+        } else {
+            while (header->magic.load() != magic_value)
+                std::this_thread::yield();
+            if (header->element_size != sizeof(T)) {
+                munmap(base, size);
+                close(fd);
+                throw std::invalid_argument("interprocess_queue element size mismatch");
+            }
+        }
+    }
+
+    ~interprocess_queue() {
+        munmap(base, size);
+        close(fd);
+    }
+
+    interprocess_queue(interprocess_queue const& other) = delete;
+    interprocess_queue& operator=(interprocess_queue const& other) = delete;
+
+    // Removes the name; mappings that are already open stay valid.
+    static void remove(std::string const& name) {
+        shm_unlink(name.c_str());
+    }
+
+    // Blocks while the queue is full.
+    void push(T const& value) {
+        lock();
+        while (full_locked())
+            wait_on(header->not_full_seq, header->push_waiters);
+        push_locked(value);
+        unlock();
+    }
+
+    bool try_push(T const& value) {
+        lock();
+        bool const ok = !full_locked();
+        if (ok)
+            push_locked(value);
+        unlock();
+        return ok;
+    }
+
+    bool try_pop(T& value) {
+        lock();
+        bool const ok = !empty_locked();
+        if (ok)
+            pop_locked(value);
+        unlock();
+        return ok;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        T value;
+        return try_pop(value) ? std::make_shared<T>(value) : std::shared_ptr<T>();
+    }
+
+    void wait_and_pop(T& value) {
+        lock();
+        while (empty_locked())
+            wait_on(header->not_empty_seq, header->pop_waiters);
+        pop_locked(value);
+        unlock();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        T value;
+        wait_and_pop(value);
+        return std::make_shared<T>(value);
+    }
+
+    bool empty() {
+        lock();
+        bool const result = empty_locked();
+        unlock();
+        return result;
+    }
+};
+
+// testing
+
+struct sample {
+    int producer;
+    int sequence;
+    double payload;
+};
+
+// Test sequential operations within one process
+void test_sequential_operations() {
+    std::string const name = "/threadsafe_ipq_seq_" + std::to_string(getpid());
+    interprocess_queue<int> queue(name, 4);
+    bool correct = true;
+
+    for (int i = 0; i < 4; ++i) {
+        correct = correct && queue.try_push(i);
+    }
+    correct = correct && !queue.try_push(4);
+
+    // A second mapping of the same object sees the same queue
+    interprocess_queue<int> other(name, 0);
+    for (int i = 0; i < 4; ++i) {
+        int value = -1;
+        correct = correct && other.try_pop(value) && value == i;
+    }
+    correct = correct && queue.empty();
+
+    interprocess_queue<int>::remove(name);
+    std::cout << (correct ? "Sequential Results correct." : "Sequential Results wrong.") << std::endl;
+}
+
+// Test a producer process feeding a consumer process through a small ring
+void test_interprocess_operations() {
+    std::string const name = "/threadsafe_ipq_fork_" + std::to_string(getpid());
+    const int num_items = 100000;
+    interprocess_queue<sample>::remove(name);
+    interprocess_queue<sample> queue(name, 64);
+
+    pid_t const child = fork();
+    if (child == 0) {
+        interprocess_queue<sample> producer(name, 0);
+        for (int i = 0; i < num_items; ++i) {
+            producer.push(sample{1, i, i * 0.5});
+        }
+        _exit(0);
+    }
+
+    bool correct = true;
+    for (int i = 0; i < num_items; ++i) {
+        sample s;
+        queue.wait_and_pop(s);
+        if (s.producer != 1 || s.sequence != i || s.payload != i * 0.5) {
+            correct = false;
+        }
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    interprocess_queue<sample>::remove(name);
+
+    if (correct && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        std::cout << "All values crossed the process boundary in order." << std::endl;
+    } else {
+        std::cout << "Some values were lost or reordered between processes." << std::endl;
+    }
+}
+
+int main() {
+    test_sequential_operations();
+    test_interprocess_operations();
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Lock_free/epoch_reclamation.h"
+
+// Ordered list with lazy synchronization (Heller et al.). contains,
+// find_first_if and for_each walk the list without taking any lock and
+// treat a node as present only if its marked flag is clear. insert and
+// remove lock just the two nodes around the change and validate that
+// neither was removed and that they are still adjacent. Unlinked nodes are
+// freed through epoch_domain once no reader can still be on them.
+// Values are kept sorted by Compare and are unique.
+template<typename T, typename Compare = std::less<T> >
+class lazy_list {
+private:
+    struct node {
+        std::shared_ptr<T> data;
+        std::atomic<node*> next;
+        std::atomic<bool> marked;
+        std::mutex m;
+
+        node() : next(nullptr), marked(false) {}
+        explicit node(T const& value) : data(std::make_shared<T>(value)), next(nullptr), marked(false) {}
+    };
+
+    node head;
+    Compare less;
+
+    // Finds pred/curr with pred < value <= curr, without locking. The
+    // caller must hold an epoch_guard.
+    void locate(T const& value, node*& pred, node*& curr) {
+        pred = &head;
+        curr = head.next.load();
+        while (curr && less(*curr->data, value)) {
+            pred = curr;
+            curr = curr->next.load();
+        }
+    }
+
+    static bool validate(node* pred, node* curr) {
+        return !pred->marked.load() && (!curr || !curr->marked.load()) && pred->next.load() == curr;
+    }
+
+    bool matches(node* curr, T const& value) const {
+        return curr && !less(value, *curr->data);
+    }
+
+public:
+    lazy_list() {}
+
+    ~lazy_list() {
+        node* current = head.next.load();
+        while (current) {
+            node* const next = current->next.load();
+            delete current;
+            current = next;
+        }
+    }
+
+    lazy_list(lazy_list const& other) = delete;
+    lazy_list& operator=(lazy_list const& other) = delete;
+
+    bool insert(T const& value) {
+        std::unique_ptr<node> new_node(new node(value));
+        epoch_guard guard;
+        for (;;) {
+            node* pred;
+            node* curr;
+            locate(value, pred, curr);
+
+            std::lock_guard<std::mutex> pred_lock(pred->m);
+            std::unique_lock<std::mutex> curr_lock;
+            if (curr)
+                curr_lock = std::unique_lock<std::mutex>(curr->m);
+            if (!validate(pred, curr))
+                continue;
+
+            if (matches(curr, value))
+                return false;
+            new_node->next.store(curr);
+            pred->next.store(new_node.release());
+            return true;
+        }
+    }
+
+    bool remove(T const& value) {
+        epoch_guard guard;
+        for (;;) {
+            node* pred;
+            node* curr;
+            locate(value, pred, curr);
+            if (!matches(curr, value))
+                return false;
+
+            {
+                std::lock_guard<std::mutex> pred_lock(pred->m);
+                std::lock_guard<std::mutex> curr_lock(curr->m);
+                if (!validate(pred, curr))
+                    continue;
+
+                curr->marked.store(true);
+                pred->next.store(curr->next.load());
+            }
+            epoch_domain::instance().retire(curr);
+            return true;
+        }
+    }
+
+    bool contains(T const& value) {
+        epoch_guard guard;
+        node* pred;
+        node* curr;
+        locate(value, pred, curr);
+        return matches(curr, value) && !curr->marked.load();
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_if(Predicate p) {
+        epoch_guard guard;
+        for (node* curr = head.next.load(); curr; curr = curr->next.load()) {
+            if (!curr->marked.load() && p(static_cast<T const&>(*curr->data)))
+                return curr->data;
+        }
+        return std::shared_ptr<T>();
+    }
+
+    template<typename Function>
+    void for_each(Function f) {
+        epoch_guard guard;
+        for (node* curr = head.next.load(); curr; curr = curr->next.load()) {
+            if (!curr->marked.load())
+                f(static_cast<T const&>(*curr->data));
+        }
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    lazy_list<int> list;
+    for (int v : {4, 2, 8, 6, 2}) {
+        list.insert(v);
+    }
+
+    std::vector<int> values;
+    list.for_each([&](int const& v) { values.push_back(v); });
+    assert((values == std::vector<int>{2, 4, 6, 8}));
+
+    assert(list.contains(6));
+    bool const removed = list.remove(6);
+    assert(removed);
+    assert(!list.contains(6));
+    bool const removed_again = list.remove(6);
+    assert(!removed_again);
+
+    std::shared_ptr<int> found = list.find_first_if([](int const& v) { return v > 4; });
+    assert(found && *found == 8);
+}
+
+void test_concurrent_operations() {
+    lazy_list<int> list;
+    const int num_writers = 3;
+    const int range = 3000;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+
+    // Even keys stay in the list the whole time; writers churn odd keys
+    for (int k = 0; k < range; k += 2) {
+        list.insert(k);
+    }
+
+    for (int t = 0; t < num_writers; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 20; ++round) {
+                for (int k = 2 * t + 1; k < range; k += 2 * num_writers) {
+                    list.insert(k);
+                }
+                for (int k = 2 * t + 1; k < range; k += 2 * num_writers) {
+                    list.remove(k);
+                }
+            }
+        });
+    }
+
+    bool readers_ok = true;
+    std::mutex readers_mutex;
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&] {
+            bool ok = true;
+            while (!done.load()) {
+                for (int k = 0; k < range; k += 97 * 2) {
+                    ok = ok && list.contains(k);
+                }
+                std::shared_ptr<int> found = list.find_first_if([](int const& v) { return v >= 1000 && v % 2 == 0; });
+                ok = ok && found && *found == 1000;
+            }
+            std::lock_guard<std::mutex> lock(readers_mutex);
+            readers_ok = readers_ok && ok;
+        });
+    }
+
+    for (int t = 0; t < num_writers; ++t) {
+        threads[t].join();
+    }
+    done.store(true);
+    for (std::size_t t = num_writers; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    int count = 0;
+    list.for_each([&](int const& v) {
+        assert(v % 2 == 0);
+        ++count;
+    });
+    assert(readers_ok);
+    assert(count == range / 2);
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Minimal userspace RCU. A reader announces the grace-period counter it
+// started under for the length of its read-side critical section and is
+// quiescent otherwise. synchronize() starts a new grace period and waits
+// until every reader is either quiescent or started after it, so anything
+// unlinked before the call can no longer be referenced.
+class rcu_domain {
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct alignas(cache_line_size) reader_record {
+        // Grace period the reader entered under, 0 when quiescent.
+        std::atomic<std::uint64_t> period{0};
+        std::atomic<bool> in_use{true};
+        unsigned nesting = 0;
+        reader_record* next = nullptr;
+    };
+
+    struct record_holder {
+        reader_record* record = nullptr;
+
+        ~record_holder() {
+            if (record)
+                record->in_use.store(false);
+        }
+    };
+
+    std::atomic<std::uint64_t> current_period{1};
+    std::atomic<reader_record*> records{nullptr};
+    std::mutex synchronize_mutex;
+
+    rcu_domain() = default;
+
+    reader_record* acquire_record() {
+        for (reader_record* r = records.load(); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true))
+                return r;
+        }
+
+        reader_record* const r = new reader_record;
+        reader_record* head = records.load();
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r));
+        return r;
+    }
+
+    reader_record* local_record() {
+        thread_local record_holder holder;
+        if (!holder.record)
+            holder.record = acquire_record();
+        return holder.record;
+    }
+
+public:
+    ~rcu_domain() {
+        reader_record* r = records.load();
+        while (r) {
+            reader_record* const next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+    rcu_domain(rcu_domain const& other) = delete;
+    rcu_domain& operator=(rcu_domain const& other) = delete;
+
+    static rcu_domain& instance() {
+        static rcu_domain domain;
+        return domain;
+    }
+
+    void read_lock() {
+        reader_record* const r = local_record();
+        if (r->nesting++ == 0) {
+            r->period.store(current_period.load(), std::memory_order_relaxed);
+            // Orders the announcement before any read of the protected data.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void read_unlock() {
+        reader_record* const r = local_record();
+        if (--r->nesting == 0)
+            r->period.store(0, std::memory_order_release);
+    }
+
+    void synchronize() {
+        std::lock_guard<std::mutex> lock(synchronize_mutex);
+        // Orders the caller's unlinks before the reader scan.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t const target = current_period.fetch_add(1) + 1;
+        for (reader_record* r = records.load(); r; r = r->next) {
+            for (;;) {
+                std::uint64_t const period = r->period.load();
+                if (period == 0 || period >= target)
+                    break;
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+class rcu_read_guard {
+public:
+    rcu_read_guard() {
+        rcu_domain::instance().read_lock();
+    }
+
+    ~rcu_read_guard() {
+        rcu_domain::instance().read_unlock();
+    }
+
+    rcu_read_guard(rcu_read_guard const& other) = delete;
+    rcu_read_guard& operator=(rcu_read_guard const& other) = delete;
+};
+
+// Read-mostly variant of threadsafe_list. for_each and find_first_if run
+// inside an RCU read-side critical section and take no locks at all; writers
+// serialize on one mutex, publish nodes with a single pointer store and free
+// unlinked nodes only after a grace period. Writers therefore pay for a
+// synchronize() per removal batch, which suits lists updated a few times a
+// minute and iterated thousands of times a second.
+template<typename T>
+class rcu_list {
+private:
+    struct node {
+        std::shared_ptr<T> data;
+        std::atomic<node*> next;
+
+        explicit node(T const& value) : data(std::make_shared<T>(value)), next(nullptr) {}
+    };
+
+    std::atomic<node*> head;
+    std::mutex write_mutex;
+
+public:
+    rcu_list() : head(nullptr) {}
+
+    ~rcu_list() {
+        node* current = head.load();
+        while (current) {
+            node* const next = current->next.load();
+            delete current;
+            current = next;
+        }
+    }
+
+    rcu_list(rcu_list const& other) = delete;
+    rcu_list& operator=(rcu_list const& other) = delete;
+
+    void push_front(T const& value) {
+        node* const new_node = new node(value);
+        std::lock_guard<std::mutex> lk(write_mutex);
+        new_node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.store(new_node, std::memory_order_release);
+    }
+
+    // Readers see the element as immutable; f must not block for long since a
+    // pending writer waits for it.
+    template<typename Function>
+    void for_each(Function f) {
+        rcu_read_guard guard;
+        for (node* current = head.load(std::memory_order_acquire); current;
+             current = current->next.load(std::memory_order_acquire))
+            f(static_cast<T const&>(*current->data));
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_if(Predicate p) {
+        rcu_read_guard guard;
+        for (node* current = head.load(std::memory_order_acquire); current;
+             current = current->next.load(std::memory_order_acquire)) {
+            if (p(static_cast<T const&>(*current->data)))
+                return current->data;
+        }
+        return std::shared_ptr<T>();
+    }
+
+    template<typename Predicate>
+    void remove_if(Predicate p) {
+        std::vector<node*> removed;
+        {
+            std::lock_guard<std::mutex> lk(write_mutex);
+            std::atomic<node*>* link = &head;
+            while (node* const current = link->load(std::memory_order_relaxed)) {
+                if (p(static_cast<T const&>(*current->data))) {
+                    // Readers already on current still follow its next pointer.
+                    link->store(current->next.load(std::memory_order_relaxed), std::memory_order_release);
+                    removed.push_back(current);
+                } else {
+                    link = &current->next;
+                }
+            }
+        }
+
+        if (removed.empty())
+            return;
+        rcu_domain::instance().synchronize();
+        for (node* n : removed)
+            delete n;
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    rcu_list<int> list;
+    for (int i = 0; i < 10; ++i) {
+        list.push_front(i);
+    }
+
+    int sum = 0;
+    list.for_each([&](int const& v) { sum += v; });
+    assert(sum == 45);
+
+    list.remove_if([](int const& v) { return v % 3 == 0; });
+    std::vector<int> rest;
+    list.for_each([&](int const& v) { rest.push_back(v); });
+    assert((rest == std::vector<int>{8, 7, 5, 4, 2, 1}));
+
+    std::shared_ptr<int> found = list.find_first_if([](int const& v) { return v < 5; });
+    assert(found && *found == 4);
+}
+
+// Readers iterate continuously while a writer churns part of the list
+void test_concurrent_operations() {
+    struct entry {
+        int key;
+        std::vector<int> payload;
+    };
+
+    rcu_list<entry> list;
+    const int stable_entries = 100;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+
+    for (int i = 0; i < stable_entries; ++i) {
+        list.push_front(entry{i, std::vector<int>(16, i)});
+    }
+
+    bool readers_ok = true;
+    std::mutex readers_mutex;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            bool ok = true;
+            long iterations = 0;
+            while (!done.load() || iterations < 10) {
+                int stable = 0;
+                list.for_each([&](entry const& e) {
+                    if (e.key < stable_entries) {
+                        ++stable;
+                    }
+                    // Payload must never be torn or freed under a reader
+                    ok = ok && e.payload.size() == 16 && e.payload[15] == e.key;
+                });
+                ok = ok && stable == stable_entries;
+                ++iterations;
+            }
+            std::lock_guard<std::mutex> lock(readers_mutex);
+            readers_ok = readers_ok && ok;
+        });
+    }
+
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            int const key = stable_entries + round * 5 + i;
+            list.push_front(entry{key, std::vector<int>(16, key)});
+        }
+        list.remove_if([](entry const& e) { return e.key >= stable_entries; });
+    }
+    done.store(true);
+
+    for (auto& r : readers) {
+        r.join();
+    }
+    assert(readers_ok);
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+// Unbounded queue built from linked fixed-size segments instead of one node
+// per element, so consumers stream through contiguous slots. Producers only
+// claim a slot under tail_mutex and construct the element after releasing
+// it; each slot carries a ready flag that consumers check instead of taking
+// tail_mutex. Segments the consumer has finished with are kept on a small
+// spare list and reused by producers before any new allocation.
+// A claimed slot must always become ready, or consumers would wait on it
+// forever, so T's move constructor may not throw.
+template<typename T, std::size_t SegmentSize = 1024>
+class segmented_queue {
+private:
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "segmented_queue requires a noexcept move constructor");
+
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t max_spare_segments = 4;
+
+    struct slot {
+        std::atomic<bool> ready;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        slot() : ready(false) {}
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(&storage));
+        }
+    };
+
+    struct segment {
+        slot slots[SegmentSize];
+        std::atomic<segment*> next;
+
+        segment() : next(nullptr) {}
+    };
+
+    alignas(cache_line_size) std::mutex head_mutex;
+    segment* head_segment;
+    std::size_t head_index;
+    std::condition_variable data_cond;
+    std::atomic<std::size_t> waiters;
+
+    alignas(cache_line_size) std::mutex tail_mutex;
+    segment* tail_segment;
+    std::size_t tail_index;
+
+    alignas(cache_line_size) std::mutex spare_mutex;
+    std::vector<segment*> spares;
+
+    segment* acquire_segment() {
+        {
+            std::lock_guard<std::mutex> lock(spare_mutex);
+            if (!spares.empty()) {
+                segment* const seg = spares.back();
+                spares.pop_back();
+                seg->next.store(nullptr);
+                return seg;
+            }
+        }
+        return new segment;
+    }
+
+    void release_segment(segment* seg) {
+        {
+            std::lock_guard<std::mutex> lock(spare_mutex);
+            if (spares.size() < max_spare_segments) {
+                spares.push_back(seg);
+                return;
+            }
+        }
+        delete seg;
+    }
+
+    // Returns the slot at the head if it holds a ready element; head_mutex
+    // must be held. Steps into the next segment once the current one is used up.
+    slot* ready_head() {
+        if (head_index == SegmentSize) {
+            segment* const next = head_segment->next.load();
+            if (!next)
+                return nullptr;
+            segment* const old = head_segment;
+            head_segment = next;
+            head_index = 0;
+            release_segment(old);
+        }
+        slot* const s = &head_segment->slots[head_index];
+        return s->ready.load() ? s : nullptr;
+    }
+
+    void consume_head(slot* s, T& value) {
+        value = std::move(*s->value());
+        s->value()->~T();
+        s->ready.store(false, std::memory_order_relaxed);
+        ++head_index;
+    }
+
+public:
+    segmented_queue() :
+        head_segment(new segment), head_index(0), waiters(0),
+        tail_segment(head_segment), tail_index(0) {}
+
+    ~segmented_queue() {
+        while (slot* s = ready_head()) {
+            s->value()->~T();
+            s->ready.store(false);
+            ++head_index;
+        }
+        delete head_segment;
+        for (segment* seg : spares)
+            delete seg;
+    }
+
+    segmented_queue(const segmented_queue& other) = delete;
+    segmented_queue& operator=(const segmented_queue& other) = delete;
+
+    void push(T new_value) {
+        slot* s;
+        {
+            std::lock_guard<std::mutex> tail_lock(tail_mutex);
+            if (tail_index == SegmentSize) {
+                segment* const fresh = acquire_segment();
+                tail_segment->next.store(fresh);
+                tail_segment = fresh;
+                tail_index = 0;
+            }
+            s = &tail_segment->slots[tail_index++];
+        }
+
+        new (&s->storage) T(std::move(new_value));
+        s->ready.store(true);
+
+        if (waiters.load() != 0) {
+            std::lock_guard<std::mutex> head_lock(head_mutex);
+            data_cond.notify_one();
+        }
+    }
+
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> head_lock(head_mutex);
+        slot* const s = ready_head();
+        if (!s)
+            return false;
+        consume_head(s, value);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::lock_guard<std::mutex> head_lock(head_mutex);
+        slot* const s = ready_head();
+        if (!s)
+            return std::shared_ptr<T>();
+        std::shared_ptr<T> res(std::make_shared<T>(std::move(*s->value())));
+        s->value()->~T();
+        s->ready.store(false, std::memory_order_relaxed);
+        ++head_index;
+        return res;
+    }
+
+    void wait_and_pop(T& value) {
+        std::unique_lock<std::mutex> head_lock(head_mutex);
+        slot* s = ready_head();
+        if (!s) {
+            waiters.fetch_add(1);
+            data_cond.wait(head_lock, [&] { return (s = ready_head()) != nullptr; });
+            waiters.fetch_sub(1);
+        }
+        consume_head(s, value);
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        T value;
+        wait_and_pop(value);
+        return std::make_shared<T>(std::move(value));
+    }
+
+    // An element whose producer is still constructing it counts as absent.
+    bool empty() {
+        std::lock_guard<std::mutex> head_lock(head_mutex);
+        return ready_head() == nullptr;
+    }
+};
+
+// testing
+
+// Test sequential operations across several small segments
+void test_sequential_operations() {
+    segmented_queue<std::string, 4> queue;
+    std::vector<std::string> results;
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            queue.push(std::to_string(round * 10 + i));
+        }
+        while (!queue.empty()) {
+            std::string item;
+            if (queue.try_pop(item)) {
+                results.push_back(item);
+            }
+        }
+    }
+
+    bool correct = results.size() == 30;
+    for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+        if (results[i] != std::to_string(i)) {
+            correct = false;
+        }
+    }
+
+    std::cout << (correct ? "Sequential Results correct." : "Sequential Results wrong.") << std::endl;
+}
+
+// Test concurrent operations with multiple producers and consumers
+void test_concurrent_operations() {
+    segmented_queue<int, 64> queue;
+    const int num_producers = 5;
+    const int num_consumers = 5;
+    const int items_per_producer = 20000;
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+    std::mutex results_mutex;
+    std::unordered_set<int> results;
+    bool ordered = true;
+
+    for (int id = 0; id < num_producers; ++id) {
+        producers.emplace_back([&, id] {
+            for (int i = 0; i < items_per_producer; ++i) {
+                queue.push(id * items_per_producer + i);
+            }
+        });
+    }
+
+    for (int c = 0; c < num_consumers; ++c) {
+        consumers.emplace_back([&] {
+            std::vector<int> local;
+            std::vector<int> last(num_producers, -1);
+            for (int i = 0; i < num_producers * items_per_producer / num_consumers; ++i) {
+                int item;
+                queue.wait_and_pop(item);
+                local.push_back(item);
+                // Values from one producer must come out in push order
+                int const producer = item / items_per_producer;
+                if (item <= last[producer]) {
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    ordered = false;
+                }
+                last[producer] = item;
+            }
+            std::lock_guard<std::mutex> lock(results_mutex);
+            results.insert(local.begin(), local.end());
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    if (ordered && results.size() == num_producers * items_per_producer && queue.empty()) {
+        std::cout << "All values were produced and consumed correctly." << std::endl;
+    } else {
+        std::cout << "Some values were missing in the results." << std::endl;
+    }
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+
+    return 0;
+}
@@ -0,0 +1,356 @@
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Serializer for trivially copyable values. A serializer for another T must
+// provide the same three static functions.
+template<typename T>
+struct trivial_serializer {
+    static_assert(std::is_trivially_copyable<T>::value, "trivial_serializer needs a trivially copyable T");
+
+    static std::size_t serialized_size(T const&) {
+        return sizeof(T);
+    }
+
+    static void serialize(T const& value, char* out) {
+        std::memcpy(out, &value, sizeof(T));
+    }
+
+    static T deserialize(char const* in, std::size_t) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return value;
+    }
+};
+
+// Unbounded FIFO queue that keeps at most memory_limit elements in RAM.
+// Once that is reached, further pushes are serialized into memory-mapped
+// segment files under spill_directory, and consumers page them back in order
+// after the in-memory elements are gone. While anything is on disk every new
+// element goes to disk too, so FIFO order is never broken. Segment files are
+// deleted as soon as they have been fully consumed.
+template<typename T, typename Serializer = trivial_serializer<T> >
+class spilling_queue {
+private:
+    struct segment {
+        std::string path;
+        int fd;
+        char* data;
+        std::size_t capacity;
+        std::size_t write_offset;
+        std::size_t read_offset;
+    };
+
+    typedef std::uint32_t record_length;
+
+    std::string const spill_directory;
+    std::size_t const memory_limit;
+    std::size_t const segment_bytes;
+
+    mutable std::mutex m;
+    std::condition_variable data_cond;
+    std::deque<T> memory;
+    std::deque<segment> segments;
+    std::size_t spilled_count;
+    std::size_t next_segment_id;
+
+    void open_segment(std::size_t min_bytes) {
+        segment seg;
+        seg.path = spill_directory + "/spill-" + std::to_string(getpid()) + "-" +
+            std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" + std::to_string(next_segment_id++);
+        seg.capacity = min_bytes > segment_bytes ? min_bytes : segment_bytes;
+        seg.write_offset = 0;
+        seg.read_offset = 0;
+
+        seg.fd = open(seg.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (seg.fd < 0)
+            throw std::system_error(errno, std::generic_category(), "open spill segment");
+        // Reserve the blocks now. A sparse file would let a full disk
+        // surface later as SIGBUS on a store through the mapping.
+        if (int const err = posix_fallocate(seg.fd, 0, static_cast<off_t>(seg.capacity))) {
+            close(seg.fd);
+            unlink(seg.path.c_str());
+            throw std::system_error(err, std::generic_category(), "fallocate spill segment");
+        }
+        void* const mapped = mmap(nullptr, seg.capacity, PROT_READ | PROT_WRITE, MAP_SHARED, seg.fd, 0);
+        if (mapped == MAP_FAILED) {
+            int const err = errno;
+            close(seg.fd);
+            unlink(seg.path.c_str());
+            throw std::system_error(err, std::generic_category(), "mmap spill segment");
+        }
+        seg.data = static_cast<char*>(mapped);
+        segments.push_back(seg);
+    }
+
+    static void close_segment(segment& seg) {
+        munmap(seg.data, seg.capacity);
+        close(seg.fd);
+        unlink(seg.path.c_str());
+    }
+
+    void spill(T const& value) {
+        std::size_t const length = Serializer::serialized_size(value);
+        if (length > std::numeric_limits<record_length>::max())
+            throw std::length_error("spilling_queue record too large");
+        std::size_t const need = sizeof(record_length) + length;
+        if (segments.empty() || segments.back().capacity - segments.back().write_offset < need)
+            open_segment(need);
+
+        segment& seg = segments.back();
+        record_length const stored = static_cast<record_length>(length);
+        std::memcpy(seg.data + seg.write_offset, &stored, sizeof(stored));
+        Serializer::serialize(value, seg.data + seg.write_offset + sizeof(stored));
+        seg.write_offset += need;
+        ++spilled_count;
+    }
+
+    T unspill() {
+        segment& seg = segments.front();
+        record_length length;
+        std::memcpy(&length, seg.data + seg.read_offset, sizeof(length));
+        T value = Serializer::deserialize(seg.data + seg.read_offset + sizeof(length), length);
+        seg.read_offset += sizeof(length) + length;
+        --spilled_count;
+
+        // The writer has moved on once a newer segment exists, so a drained
+        // front segment can go.
+        if (seg.read_offset == seg.write_offset && (segments.size() > 1 || spilled_count == 0)) {
+            close_segment(seg);
+            segments.pop_front();
+        }
+        return value;
+    }
+
+    bool has_data() const {
+        return !memory.empty() || spilled_count != 0;
+    }
+
+    T pop_locked() {
+        if (!memory.empty()) {
+            T value = std::move(memory.front());
+            memory.pop_front();
+            return value;
+        }
+        return unspill();
+    }
+
+public:
+    spilling_queue(std::string const& spill_directory_, std::size_t memory_limit_,
+                   std::size_t segment_bytes_ = 64 * 1024 * 1024) :
+        spill_directory(spill_directory_), memory_limit(memory_limit_), segment_bytes(segment_bytes_),
+        spilled_count(0), next_segment_id(0) {}
+
+    ~spilling_queue() {
+        for (segment& seg : segments)
+            close_segment(seg);
+    }
+
+    spilling_queue(spilling_queue const& other) = delete;
+    spilling_queue& operator=(spilling_queue const& other) = delete;
+
+    void push(T new_value) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (spilled_count == 0 && memory.size() < memory_limit)
+                memory.push_back(std::move(new_value));
+            else
+                spill(new_value);
+        }
+        data_cond.notify_one();
+    }
+
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!has_data())
+            return false;
+        value = pop_locked();
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::lock_guard<std::mutex> lock(m);
+        if (!has_data())
+            return std::shared_ptr<T>();
+        return std::make_shared<T>(pop_locked());
+    }
+
+    void wait_and_pop(T& value) {
+        std::unique_lock<std::mutex> lock(m);
+        data_cond.wait(lock, [this] { return has_data(); });
+        value = pop_locked();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::unique_lock<std::mutex> lock(m);
+        data_cond.wait(lock, [this] { return has_data(); });
+        return std::make_shared<T>(pop_locked());
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lock(m);
+        return !has_data();
+    }
+
+    std::size_t spilled() const {
+        std::lock_guard<std::mutex> lock(m);
+        return spilled_count;
+    }
+};
+
+// testing
+
+struct string_serializer {
+    static std::size_t serialized_size(std::string const& value) {
+        return value.size();
+    }
+
+    static void serialize(std::string const& value, char* out) {
+        std::memcpy(out, value.data(), value.size());
+    }
+
+    static std::string deserialize(char const* in, std::size_t length) {
+        return std::string(in, length);
+    }
+};
+
+// Test that order survives the memory -> disk -> memory transitions
+void test_sequential_operations() {
+    spilling_queue<int> queue("/tmp", 100, 4096);
+    std::vector<int> results;
+    bool correct = true;
+
+    for (int i = 0; i < 5000; ++i) {
+        queue.push(i);
+    }
+    correct = correct && queue.spilled() == 4900;
+
+    // Interleave pops and pushes so the queue switches modes several times
+    for (int i = 5000; i < 6000; ++i) {
+        int item;
+        if (queue.try_pop(item)) {
+            results.push_back(item);
+        }
+        queue.push(i);
+    }
+    while (!queue.empty()) {
+        int item;
+        if (queue.try_pop(item)) {
+            results.push_back(item);
+        }
+    }
+
+    for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+        if (results[i] != i) {
+            correct = false;
+        }
+    }
+    correct = correct && results.size() == 6000 && queue.spilled() == 0;
+
+    std::cout << (correct ? "Sequential Results kept FIFO order across spills." : "Sequential Results out of order.") << std::endl;
+}
+
+// Test producers and consumers with variable-length values on disk
+void test_concurrent_operations() {
+    spilling_queue<std::string, string_serializer> queue("/tmp", 64, 16 * 1024);
+    const int num_producers = 4;
+    const int items_per_producer = 5000;
+    std::vector<std::thread> producers;
+    std::vector<int> next_expected(num_producers, 0);
+    bool correct = true;
+
+    auto producer = [&](int id) {
+        for (int i = 0; i < items_per_producer; ++i) {
+            queue.push(std::to_string(id) + ":" + std::to_string(i) + ":" + std::string(i % 200, 'x'));
+        }
+    };
+
+    for (int i = 0; i < num_producers; ++i) {
+        producers.emplace_back(producer, i);
+    }
+
+    for (int n = 0; n < num_producers * items_per_producer; ++n) {
+        std::shared_ptr<std::string> item = queue.wait_and_pop();
+        std::size_t const first = item->find(':');
+        std::size_t const second = item->find(':', first + 1);
+        int const id = std::stoi(item->substr(0, first));
+        int const i = std::stoi(item->substr(first + 1, second - first - 1));
+        if (i != next_expected[id] || item->size() - second - 1 != static_cast<std::size_t>(i % 200)) {
+            correct = false;
+        }
+        next_expected[id] = i + 1;
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    if (correct && queue.empty()) {
+        std::cout << "All values were produced and consumed correctly." << std::endl;
+    } else {
+        std::cout << "Some values were missing in the results." << std::endl;
+    }
+}
+
+// Serializer that claims a size no record length field can hold
+struct oversized_serializer {
+    static std::size_t serialized_size(int const&) {
+        return std::size_t(std::numeric_limits<std::uint32_t>::max()) + 1;
+    }
+
+    static void serialize(int const&, char*) {}
+
+    static int deserialize(char const*, std::size_t) {
+        return 0;
+    }
+};
+
+// Test that spill failures surface as exceptions and leave the queue usable
+void test_error_operations() {
+    bool correct = true;
+
+    spilling_queue<int, oversized_serializer> oversized("/tmp", 0, 4096);
+    try {
+        oversized.push(1);
+        correct = false;
+    } catch (std::length_error const&) {
+    }
+    correct = correct && oversized.empty();
+
+    spilling_queue<int> missing("/nonexistent-spill-directory", 1, 4096);
+    missing.push(1);
+    try {
+        missing.push(2);
+        correct = false;
+    } catch (std::system_error const&) {
+    }
+    int item = 0;
+    correct = correct && missing.try_pop(item) && item == 1 && missing.empty();
+
+    std::cout << (correct ? "Spill errors were reported." : "Spill errors were not reported.") << std::endl;
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+    test_error_operations();
+
+    return 0;
+}
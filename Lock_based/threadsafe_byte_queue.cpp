@@ -0,0 +1,327 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Queue of variable-length byte records stored back to back in one ring.
+// Producers reserve(n) a span, write into it in place and commit; the
+// consumer reads a span view and releases it once processed. No record
+// ever touches the heap. Many producers may reserve concurrently; records
+// are consumed in reservation order by a single consumer thread, which must
+// release them in the order they were read.
+class threadsafe_byte_queue {
+private:
+    static constexpr std::size_t alignment = 8;
+
+    enum record_state : std::uint32_t { reserved, committed, padding };
+
+    struct record_header {
+        std::uint32_t length;
+        std::atomic<std::uint32_t> state;
+    };
+
+    static_assert(sizeof(record_header) == alignment, "record header must stay one alignment unit");
+
+    static std::size_t record_size(std::size_t length) {
+        return sizeof(record_header) + ((length + alignment - 1) & ~(alignment - 1));
+    }
+
+public:
+    class reservation {
+    public:
+        reservation() : data(nullptr), size(0), header(nullptr) {}
+
+        char* data;
+        std::size_t size;
+
+    private:
+        friend class threadsafe_byte_queue;
+        record_header* header;
+    };
+
+    class record {
+    public:
+        record() : data(nullptr), size(0), end(0) {}
+
+        char const* data;
+        std::size_t size;
+
+    private:
+        friend class threadsafe_byte_queue;
+        std::uint64_t end;
+    };
+
+private:
+    std::vector<std::uint64_t> storage;
+    char* const buffer;
+    std::size_t const capacity;
+    std::size_t const mask;
+
+    std::mutex write_mutex;
+    std::condition_variable space_cond;
+    std::atomic<std::uint64_t> write_pos;
+    std::atomic<std::size_t> producers_waiting;
+
+    std::mutex read_mutex;
+    std::condition_variable data_cond;
+    std::atomic<std::uint64_t> read_pos;
+    std::atomic<std::size_t> consumers_waiting;
+    std::uint64_t read_cursor;
+
+    record_header* header_at(std::uint64_t position) {
+        return reinterpret_cast<record_header*>(buffer + (position & mask));
+    }
+
+    // Claims space for one record under write_mutex, writing a padding record
+    // first if the record would otherwise straddle the end of the ring.
+    bool reserve_locked(std::unique_lock<std::mutex>& lock, std::size_t length, reservation& res, bool wait) {
+        std::size_t const need = record_size(length);
+        if (length > UINT32_MAX || need > capacity)
+            throw std::length_error("record larger than byte queue capacity");
+
+        // Other producers may reserve while this one sleeps, so the write
+        // position is re-read every time the space check runs.
+        std::uint64_t position;
+        std::size_t skip;
+        auto has_space = [&] {
+            position = write_pos.load(std::memory_order_relaxed);
+            std::size_t const tail_room = capacity - (position & mask);
+            skip = tail_room < need ? tail_room : 0;
+            return capacity - (position - read_pos.load()) >= skip + need;
+        };
+        if (!has_space()) {
+            if (!wait)
+                return false;
+            producers_waiting.fetch_add(1);
+            space_cond.wait(lock, has_space);
+            producers_waiting.fetch_sub(1);
+        }
+
+        if (skip) {
+            record_header* const pad = header_at(position);
+            pad->length = static_cast<std::uint32_t>(skip - sizeof(record_header));
+            pad->state.store(padding, std::memory_order_relaxed);
+            position += skip;
+        }
+
+        record_header* const header = header_at(position);
+        header->length = static_cast<std::uint32_t>(length);
+        header->state.store(reserved, std::memory_order_relaxed);
+        write_pos.store(position + need, std::memory_order_release);
+
+        res.header = header;
+        res.data = reinterpret_cast<char*>(header + 1);
+        res.size = length;
+        return true;
+    }
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit threadsafe_byte_queue(std::size_t capacity_) :
+        storage(round_up(capacity_) / sizeof(std::uint64_t)),
+        buffer(reinterpret_cast<char*>(storage.data())),
+        capacity(storage.size() * sizeof(std::uint64_t)),
+        mask(capacity - 1),
+        write_pos(0), producers_waiting(0),
+        read_pos(0), consumers_waiting(0), read_cursor(0) {}
+
+    threadsafe_byte_queue(threadsafe_byte_queue const& other) = delete;
+    threadsafe_byte_queue& operator=(threadsafe_byte_queue const& other) = delete;
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t result = 64;
+        while (result < n)
+            result <<= 1;
+        return result;
+    }
+
+    // Blocks until length bytes are free and returns a writable span.
+    reservation reserve(std::size_t length) {
+        std::unique_lock<std::mutex> lock(write_mutex);
+        reservation res;
+        reserve_locked(lock, length, res, true);
+        return res;
+    }
+
+    bool try_reserve(std::size_t length, reservation& res) {
+        std::unique_lock<std::mutex> lock(write_mutex);
+        return reserve_locked(lock, length, res, false);
+    }
+
+    // Publishes a reserved record. Records may be committed out of order;
+    // the consumer still sees them in reservation order.
+    void commit(reservation const& res) {
+        res.header->state.store(committed);
+        if (consumers_waiting.load() != 0) {
+            std::lock_guard<std::mutex> lock(read_mutex);
+            data_cond.notify_one();
+        }
+    }
+
+    void push(void const* bytes, std::size_t length) {
+        reservation res = reserve(length);
+        std::memcpy(res.data, bytes, length);
+        commit(res);
+    }
+
+    // Returns the next committed record without copying it. The span stays
+    // valid until release() is called for it.
+    bool try_read(record& rec) {
+        for (;;) {
+            if (read_cursor == write_pos.load(std::memory_order_acquire))
+                return false;
+
+            record_header* const header = header_at(read_cursor);
+            std::uint32_t const state = header->state.load();
+            if (state == padding) {
+                read_cursor += sizeof(record_header) + header->length;
+                continue;
+            }
+            if (state != committed)
+                return false;
+
+            rec.data = reinterpret_cast<char const*>(header + 1);
+            rec.size = header->length;
+            read_cursor += record_size(header->length);
+            rec.end = read_cursor;
+            return true;
+        }
+    }
+
+    record wait_and_read() {
+        record rec;
+        if (try_read(rec))
+            return rec;
+
+        consumers_waiting.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(read_mutex);
+            data_cond.wait(lock, [&] { return try_read(rec); });
+        }
+        consumers_waiting.fetch_sub(1);
+        return rec;
+    }
+
+    // Hands the record's bytes (and any padding before it) back to producers.
+    void release(record const& rec) {
+        read_pos.store(rec.end);
+        if (producers_waiting.load() != 0) {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            space_cond.notify_all();
+        }
+    }
+
+    bool empty() {
+        return read_pos.load() == write_pos.load();
+    }
+};
+
+// testing
+
+// Test in-place reserve/commit and wrap-around with a small ring
+void test_sequential_operations() {
+    threadsafe_byte_queue queue(256);
+    bool correct = true;
+
+    for (int round = 0; round < 20; ++round) {
+        std::size_t const length = 10 + (round * 37) % 90;
+        threadsafe_byte_queue::reservation res = queue.reserve(length);
+        std::memset(res.data, 'a' + round % 26, length);
+        queue.commit(res);
+
+        threadsafe_byte_queue::record rec;
+        if (!queue.try_read(rec) || rec.size != length) {
+            correct = false;
+            break;
+        }
+        for (std::size_t i = 0; i < rec.size; ++i) {
+            if (rec.data[i] != 'a' + round % 26) {
+                correct = false;
+            }
+        }
+        queue.release(rec);
+    }
+
+    // A full ring refuses further reservations until the consumer releases
+    threadsafe_byte_queue::reservation res;
+    while (queue.try_reserve(40, res)) {
+        queue.commit(res);
+    }
+    threadsafe_byte_queue::record rec;
+    queue.try_read(rec);
+    queue.release(rec);
+    if (!queue.try_reserve(40, res)) {
+        correct = false;
+    }
+
+    std::cout << (correct ? "Sequential reserve/commit correct." : "Sequential reserve/commit wrong.") << std::endl;
+}
+
+// Test multiple producers writing 50-4000 byte records through a 64KB ring
+void test_concurrent_operations() {
+    threadsafe_byte_queue queue(64 * 1024);
+    const int num_producers = 4;
+    const int records_per_producer = 5000;
+    std::vector<std::thread> producers;
+
+    auto producer = [&](int id) {
+        for (int i = 0; i < records_per_producer; ++i) {
+            std::size_t const length = 50 + (i * 7919 + id * 104729) % 3951;
+            threadsafe_byte_queue::reservation res = queue.reserve(length);
+            std::int32_t const header[2] = {id, i};
+            std::memcpy(res.data, header, sizeof(header));
+            std::memset(res.data + sizeof(header), id + i, length - sizeof(header));
+            queue.commit(res);
+        }
+    };
+
+    for (int i = 0; i < num_producers; ++i) {
+        producers.emplace_back(producer, i);
+    }
+
+    std::vector<int> next_expected(num_producers, 0);
+    bool correct = true;
+    for (int n = 0; n < num_producers * records_per_producer; ++n) {
+        threadsafe_byte_queue::record rec = queue.wait_and_read();
+        std::int32_t header[2];
+        std::memcpy(header, rec.data, sizeof(header));
+        int const id = header[0];
+        int const i = header[1];
+        if (id < 0 || id >= num_producers || i != next_expected[id]) {
+            correct = false;
+            queue.release(rec);
+            continue;
+        }
+        ++next_expected[id];
+        for (std::size_t b = sizeof(header); b < rec.size; ++b) {
+            if (rec.data[b] != static_cast<char>(id + i)) {
+                correct = false;
+                break;
+            }
+        }
+        queue.release(rec);
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    if (correct && queue.empty()) {
+        std::cout << "All records were produced and consumed correctly." << std::endl;
+    } else {
+        std::cout << "Some records were missing or corrupted." << std::endl;
+    }
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+
+    return 0;
+}
@@ -1,57 +1,341 @@
 #include<memory>
 #include<mutex>
+#include<shared_mutex>
+#include<condition_variable>
+#include<exception>
+#include<functional>
+#include<queue>
+#include<unordered_set>
+#include<vector>
+#include<iterator>
+#include<cstddef>
+#include<optional>
+#include<string>
+#include<algorithm>
+#include<type_traits>
+#include<thread>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+#include<cassert>
+#include<atomic>
+#include<stdexcept>
 
+// Arena of list nodes. Nodes are carved out of fixed-size blocks and handed
+// back to a free list instead of being deleted, so steady-state push_front /
+// remove_if traffic never reaches malloc for the nodes themselves. Blocks are
+// only freed with the pool. Callers drop whatever a node owns before
+// releasing it.
+// A recycled node can come back at a different position relative to the same
+// neighbours, so ThreadSanitizer's lock-order checker reports cycles that
+// hand-over-hand locking cannot actually form. Run it with detect_deadlocks=0.
+template<typename Node>
+class node_pool{
+private:
+    static constexpr std::size_t block_size = 256;
+
+    std::mutex m;
+    std::vector<std::unique_ptr<Node[]> > blocks;
+    std::vector<Node*> free_nodes;
+
+public:
+    node_pool(){}
+
+    node_pool(node_pool const& other)=delete;
+    node_pool& operator=(node_pool const& other)=delete;
+
+    Node* acquire(){
+        std::lock_guard<std::mutex> lk(m);
+        if(free_nodes.empty()){
+            blocks.emplace_back(new Node[block_size]);
+            Node* const block=blocks.back().get();
+            for(std::size_t i=block_size;i>0;--i)
+                free_nodes.push_back(&block[i-1]);
+        }
+        Node* const n=free_nodes.back();
+        free_nodes.pop_back();
+        return n;
+    }
+
+    // Returns a chain of nodes linked through next with one lock acquisition.
+    void release_chain(Node* first){
+        std::lock_guard<std::mutex> lk(m);
+        while(first){
+            Node* const next=first->next;
+            first->next=nullptr;
+            free_nodes.push_back(first);
+            first=next;
+        }
+    }
+};
+
+// Immutable point-in-time view of a threadsafe_list, iterated with range-for.
 template<typename T>
+class list_snapshot{
+private:
+    typedef std::vector<std::shared_ptr<T const> > items_type;
+    items_type items;
+
+public:
+    class const_iterator{
+    private:
+        typename items_type::const_iterator it;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T const* pointer;
+        typedef T const& reference;
+
+        const_iterator(){}
+        explicit const_iterator(typename items_type::const_iterator it_): it(it_) {}
+
+        reference operator*() const{return **it;}
+        pointer operator->() const{return it->get();}
+        const_iterator& operator++(){++it; return *this;}
+        const_iterator operator++(int){const_iterator old(*this); ++it; return old;}
+        bool operator==(const_iterator const& other) const{return it==other.it;}
+        bool operator!=(const_iterator const& other) const{return it!=other.it;}
+    };
+
+    list_snapshot(){}
+    explicit list_snapshot(items_type items_): items(std::move(items_)) {}
+
+    const_iterator begin() const{return const_iterator(items.begin());}
+    const_iterator end() const{return const_iterator(items.end());}
+    std::size_t size() const{return items.size();}
+    bool empty() const{return items.empty();}
+};
+
+// Read-only traversals take shared locks when the node mutex offers them.
+template<typename Mutex, typename=void>
+struct node_read_lock{
+    typedef std::unique_lock<Mutex> type;
+};
+
+template<typename Mutex>
+struct node_read_lock<Mutex, std::void_t<decltype(std::declval<Mutex&>().lock_shared())> >{
+    typedef std::shared_lock<Mutex> type;
+};
+
+// Mutex is the per-node lock. With a shared mutex such as std::shared_mutex,
+// for_each_shared, find_first_if, find_first_if_visit, find_first_copy and
+// the parallel walks take shared locks, so concurrent readers can pass each
+// other along the chain. Writers still lock each node exclusively.
+template<typename T, typename Mutex=std::mutex>
 class threadsafe_list{
 private:
+    typedef std::unique_lock<Mutex> write_lock;
+    typedef typename node_read_lock<Mutex>::type read_lock;
+
     struct node{
         std::shared_ptr<T> data;
-        std::unique_ptr<T> next;
-        std::mutex m;
+        node* next;
+        Mutex m;
+        // Set when data has been handed to a snapshot or a parallel task.
+        // Possibly set by several readers at once under shared locks.
+        std::atomic<bool> published;
 
-        node(): next() {}
-        node(T const& value): data(std::make_shared<T>(value)){};
+        node(): next(nullptr), published(false) {}
     };
-    
+
     node head;
+    node_pool<node> pool;
+
+    // Last node, or &head when the list is empty. It is only changed by a
+    // thread holding the lock of the node it points to, so that lock also
+    // guards the tail.
+    std::atomic<node*> tail;
+    std::atomic<std::size_t> count;
+
+    // Counts outstanding executor tasks and keeps the first exception one of
+    // them threw so the caller can rethrow it.
+    struct task_group{
+        std::mutex m;
+        std::condition_variable cv;
+        std::size_t pending=0;
+        std::exception_ptr error;
+
+        template<typename Executor, typename Task>
+        void run(Executor& executor, Task task){
+            {
+                std::lock_guard<std::mutex> lk(m);
+                ++pending;
+            }
+            executor.submit([this, task]() mutable{
+                std::exception_ptr caught;
+                try{
+                    task();
+                }catch(...){
+                    caught=std::current_exception();
+                }
+                std::lock_guard<std::mutex> lk(m);
+                if(caught && !error)
+                    error=caught;
+                if(--pending==0)
+                    cv.notify_all();
+            });
+        }
+
+        void wait(){
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk,[this]{return pending==0;});
+            if(error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    typedef std::vector<std::shared_ptr<T const> > chunk_type;
+
+    // Walks the list hand-over-hand and copies the payload pointers out in
+    // chunks of chunk_size. No user code runs while a node is locked; the
+    // shared_ptrs keep each element alive after its node lock is released,
+    // even if the node is removed meanwhile.
+    std::vector<chunk_type> collect_chunks(std::size_t chunk_size){
+        std::vector<chunk_type> chunks;
+        node* current=&head;
+        read_lock lk(head.m);
+        while(node* const next=current->next){
+            read_lock next_lk(next->m);
+            lk.unlock();
+            if(chunks.empty() || chunks.back().size()==chunk_size){
+                chunks.emplace_back();
+                chunks.back().reserve(chunk_size);
+            }
+            next->published.store(true, std::memory_order_relaxed);
+            chunks.back().push_back(next->data);
+            current=next;
+            lk=std::move(next_lk);
+        }
+        return chunks;
+    }
+
+    node* make_node(T const& value){
+        node* const new_node=pool.acquire();
+        new_node->data=std::make_shared<T>(value);
+        new_node->published.store(false, std::memory_order_relaxed);
+        return new_node;
+    }
+
+    // A payload that a snapshot or a parallel task may still be reading is
+    // replaced by a private copy before it is changed, so those readers keep
+    // the value they saw. Payloads never published are written in place, and
+    // a published one is copied only once, by the first write after it was
+    // handed out (even if the snapshot holding it is already gone). Call with
+    // the node locked exclusively.
+    static T& writable(node& n){
+        if(n.published.load(std::memory_order_relaxed)){
+            n.data=std::make_shared<T>(static_cast<T const&>(*n.data));
+            n.published.store(false, std::memory_order_relaxed);
+        }
+        return *n.data;
+    }
+
+    template<bool Writes, typename Predicate, typename Function>
+    bool visit_first_if(Predicate& p, Function&& f){
+        typedef std::conditional_t<Writes, write_lock, read_lock> lock_type;
+        node* current=&head;
+        lock_type lk(head.m);
+        while(node* const next=current->next){
+            lock_type next_lk(next->m);
+            lk.unlock();
+            if(p(static_cast<T const&>(*next->data))){
+                if constexpr(Writes)
+                    f(writable(*next));
+                else
+                    f(static_cast<T const&>(*next->data));
+                return true;
+            }
+            current=next;
+            lk=std::move(next_lk);
+        }
+        return false;
+    }
 
 public:
-    threadsafe_list(){}
+    threadsafe_list(): tail(&head), count(0) {}
     ~threadsafe_list(){
-        std::remove_if([](T const&){return true;});
+        remove_if([](T const&){return true;});
     }
 
     threadsafe_list(threadsafe_list const& other)=delete;
     threadsafe_list& operator=(threadsafe_list const& other)=delete;
 
     void push_front(T const& value){
-        std::unique_ptr<node> new_node(new node(value));
-        std::lock_guard<std::mutex> lk(head.m);
-        new_node -> next = std::move(head.next);
-        head.next = std::move(new_node);
+        node* const new_node=make_node(value);
+        std::lock_guard<Mutex> lk(head.m);
+        new_node->next=head.next;
+        head.next=new_node;
+        if(!new_node->next)
+            tail.store(new_node, std::memory_order_release);
+        ++count;
+    }
+
+    // Appends after the current last node. If that node stopped being the
+    // tail while we waited for its lock, we retry. Locking a node that has
+    // since been removed is harmless because pool memory lives as long as
+    // the list.
+    void push_back(T const& value){
+        node* const new_node=make_node(value);
+        for(;;){
+            node* const last=tail.load(std::memory_order_acquire);
+            std::lock_guard<Mutex> last_lk(last->m);
+            if(tail.load(std::memory_order_acquire)!=last)
+                continue;
+            last->next=new_node;
+            tail.store(new_node, std::memory_order_release);
+            ++count;
+            return;
+        }
+    }
+
+    // Exact when no other thread is modifying the list; otherwise a value
+    // the size passed through recently.
+    std::size_t size() const{
+        return count.load();
     }
 
     template<typename Function>
     void for_each(Function f){
         node* current = &head;
-        std::unique_lock<std::mutex> lk(head.m);
-        while(node* const next=current->next.get()){
-            std::unique_lock<std::mutex> next_lk(next->m);
+        write_lock lk(head.m);
+        while(node* const next=current->next){
+            write_lock next_lk(next->m);
+            lk.unlock();
+            f(writable(*next));
+            current=next;
+            lk=std::move(next_lk);
+        }
+    }
+
+    // Read-only for_each: f gets the element as const and may run alongside
+    // other readers of the same node.
+    template<typename Function>
+    void for_each_shared(Function f){
+        node* current = &head;
+        read_lock lk(head.m);
+        while(node* const next=current->next){
+            read_lock next_lk(next->m);
             lk.unlock();
-            f(*next->data);
+            f(static_cast<T const&>(*next->data));
             current=next;
             lk=std::move(next_lk);
         }
     }
 
+    // The returned pointer shares the element with the list and keeps it
+    // alive after removal. It sees later in-place updates only until a
+    // snapshot or parallel walk publishes the element. The next write after
+    // that goes to a copy, and the pointer keeps the value it had.
     template<typename Predicate>
     std::shared_ptr<T> find_first_if(Predicate p){
         node* current = &head;
-        std::unique_lock<std::mutex> lk(head.m);
-        while(node* const next=current->next.get()){
-            std::unique_lock<std::mutex> next_lk(next->m);
+        read_lock lk(head.m);
+        while(node* const next=current->next){
+            read_lock next_lk(next->m);
             lk.unlock();
-            if(p(*next->data)){
+            if(p(static_cast<T const&>(*next->data))){
                 return next->data;
             }
             current=next;
@@ -60,27 +344,725 @@ public:
         return std::shared_ptr<T>();
     }
 
+    // Applies mutator to the first element matching p while that node is
+    // still locked, so no other traversal sees it half-updated. Returns
+    // whether a match was found.
+    template<typename Predicate, typename Mutator>
+    bool update_first_if(Predicate p, Mutator mutator){
+        return visit_first_if<true>(p, mutator);
+    }
+
+    // Runs visitor on the first element matching p under that node's lock
+    // and returns its result by value. Unlike find_first_if this takes no
+    // reference on the element, so hot elements do not bounce a shared_ptr
+    // control block between threads. Returns std::optional of the visitor's
+    // result, or bool if the visitor returns void.
+    template<typename Predicate, typename Visitor>
+    auto find_first_if_visit(Predicate p, Visitor visitor){
+        typedef std::invoke_result_t<Visitor&, T const&> result_type;
+        if constexpr(std::is_void<result_type>::value){
+            return visit_first_if<false>(p,[&](T const& value){visitor(value);});
+        }else{
+            std::optional<std::decay_t<result_type> > result;
+            visit_first_if<false>(p,[&](T const& value){result.emplace(visitor(value));});
+            return result;
+        }
+    }
+
+    // Copies the first element matching p out while its node is locked.
     template<typename Predicate>
-    void remove_if(Predicate p){
+    std::optional<T> find_first_copy(Predicate p){
+        std::optional<T> result;
+        visit_first_if<false>(p,[&](T const& value){result.emplace(value);});
+        return result;
+    }
+
+    // As update_first_if for every matching element; returns how many were
+    // updated.
+    template<typename Predicate, typename Mutator>
+    std::size_t update_all_if(Predicate p, Mutator mutator){
+        std::size_t updated=0;
         node* current=&head;
-        std::unique_lock<std::mutex> lk(head.m);
-        while(node* const next=current->next.get())
+        write_lock lk(head.m);
+        while(node* const next=current->next){
+            write_lock next_lk(next->m);
+            lk.unlock();
+            if(p(static_cast<T const&>(*next->data))){
+                mutator(writable(*next));
+                ++updated;
+            }
+            current=next;
+            lk=std::move(next_lk);
+        }
+        return updated;
+    }
+
+    // Returns the elements as they all were at one instant. The walk keeps
+    // every node lock it takes until it reaches the end (shared locks if
+    // Mutex has them). Once the last lock is taken, no node already seen can
+    // change, so the copied pointers form a consistent cut. Locks are held
+    // only while pointers are copied, never while user code runs. Writers
+    // copy a payload before changing it once a snapshot has taken it, so the
+    // view stays immutable and can be iterated without any list lock.
+    // Taking the snapshot is O(n) and holds up to n+1 node locks at the
+    // end. With the default std::mutex those locks are exclusive, so every
+    // reader and writer behind the walk waits until it finishes. Use
+    // std::shared_mutex as Mutex when snapshots are frequent; readers can
+    // then pass, and only writers wait.
+    list_snapshot<T> snapshot(){
+        std::vector<std::shared_ptr<T const> > items;
+        std::vector<read_lock> held;
+        std::size_t const expected=count.load();
+        items.reserve(expected);
+        held.reserve(expected+1);
+        held.emplace_back(head.m);
+        for(node* n=head.next;n;n=n->next){
+            held.emplace_back(n->m);
+            n->published.store(true, std::memory_order_relaxed);
+            items.push_back(n->data);
+        }
+        return list_snapshot<T>(std::move(items));
+    }
+
+    // Runs f on every element using executor.submit(std::function<void()>).
+    // The calling thread first walks the list as for_each_shared does and
+    // collects the elements in chunks of chunk_size. Once every node lock is
+    // released, each chunk is submitted as one task. f gets each element as
+    // const and runs outside the node locks, possibly concurrently with f on
+    // other elements. Writers copy an element before changing it while a
+    // chunk still holds it, so f always reads a stable value.
+    // Returns once every task has finished.
+    template<typename Executor, typename Function>
+    void parallel_for_each(Executor& executor, Function f, std::size_t chunk_size=256){
+        task_group group;
+        for(chunk_type& chunk:collect_chunks(chunk_size)){
+            group.run(executor,[chunk=std::move(chunk), f]() mutable{
+                for(std::shared_ptr<T const> const& item:chunk)
+                    f(*item);
+            });
+        }
+        group.wait();
+    }
+
+    // Evaluates p in parallel as parallel_for_each does, then unlinks the
+    // matching elements in a single hand-over-hand pass. Elements are matched
+    // by identity, so an element added, or rewritten by a writer, after the
+    // evaluation phase is never removed.
+    template<typename Executor, typename Predicate>
+    void parallel_remove_if(Executor& executor, Predicate p, std::size_t chunk_size=256){
+        task_group group;
+        std::mutex matches_mutex;
+        std::unordered_set<T const*> matches;
+
+        // chunks pins every payload, so no matched address can be recycled
+        // for a new element before the removal pass.
+        std::vector<chunk_type> const chunks=collect_chunks(chunk_size);
+        for(chunk_type const& chunk:chunks){
+            group.run(executor,[&chunk, &matches, &matches_mutex, p]() mutable{
+                std::vector<T const*> local;
+                for(std::shared_ptr<T const> const& item:chunk){
+                    if(p(*item))
+                        local.push_back(item.get());
+                }
+                std::lock_guard<std::mutex> lk(matches_mutex);
+                matches.insert(local.begin(), local.end());
+            });
+        }
+        group.wait();
+
+        if(!matches.empty())
+            remove_if([&](T const& value){return matches.count(&value)!=0;});
+    }
+
+    // Unlinked nodes are gathered on a local garbage chain, kept in list order.
+    // Their payloads are destroyed and the nodes handed back to the pool only
+    // after the last node lock is dropped, so neither T's destructor nor the
+    // pool mutex holds up traversals queued behind us.
+    template<typename Predicate>
+    void remove_if(Predicate p){
+        node* garbage=nullptr;
+        node** garbage_tail=&garbage;
+        std::size_t removed=0;
         {
-            std::unique_lock<std::mutex> next_lk(next->m);
-            if(p(*next->data))
+            node* current=&head;
+            write_lock lk(head.m);
+            while(node* const next=current->next)
             {
-                std::unique_ptr<node> old_next=std::move(current->next);
-                current->next=std::move(next->next);
-                next_lk.unlock();
+                write_lock next_lk(next->m);
+                if(p(static_cast<T const&>(*next->data)))
+                {
+                    // Nobody else can reach next once it is unlinked under both locks.
+                    current->next=next->next;
+                    if(!current->next)
+                        tail.store(current, std::memory_order_release);
+                    next->next=nullptr;
+                    ++removed;
+                    *garbage_tail=next;
+                    garbage_tail=&next->next;
+                    next_lk.unlock();
+                }
+                else
+                {
+                    lk.unlock();
+                    current=next;
+                    lk=std::move(next_lk);
+                }
             }
-            else
-            {
-                lk.unlock();
-                current=next;
-                lk=std::move(next_lk);
+        }
+        count-=removed;
+        for(node* n=garbage;n;n=n->next)
+            n->data.reset();
+        pool.release_chain(garbage);
+    }
+};
+
+// testing
+// Define THREADSAFE_LIST_NO_TESTS to include this file for the class alone.
+#ifndef THREADSAFE_LIST_NO_TESTS
+
+void test_sequential_operations(){
+    threadsafe_list<int> list;
+    for(int i=0;i<10;++i)
+        list.push_front(i);
+
+    int sum=0;
+    list.for_each([&](int& v){sum+=v;});
+    assert(sum==45);
+
+    std::shared_ptr<int> found=list.find_first_if([](int const& v){return v==7;});
+    assert(found && *found==7);
+
+    list.remove_if([](int const& v){return v%2==0;});
+    std::vector<int> rest;
+    list.for_each([&](int& v){rest.push_back(v);});
+    assert((rest==std::vector<int>{9,7,5,3,1}));
+    assert(!list.find_first_if([](int const& v){return v==4;}));
+
+    // The shared_ptr handed out keeps its value even after removal and reuse
+    list.remove_if([](int const&){return true;});
+    for(int i=100;i<110;++i)
+        list.push_front(i);
+    assert(*found==7);
+
+    // remove_if frees the payload rather than parking it in the pool
+    threadsafe_list<std::shared_ptr<int> > owners;
+    std::shared_ptr<int> owned=std::make_shared<int>(1);
+    std::weak_ptr<int> watch=owned;
+    owners.push_front(owned);
+    owned.reset();
+    owners.remove_if([](std::shared_ptr<int> const&){return true;});
+    assert(watch.expired());
+}
+
+void test_concurrent_operations(){
+    threadsafe_list<int> list;
+    const int num_threads=4;
+    const int items_per_thread=2000;
+    std::vector<std::thread> threads;
+
+    for(int t=0;t<num_threads;++t){
+        threads.emplace_back([&,t]{
+            for(int i=0;i<items_per_thread;++i){
+                int const value=t*items_per_thread+i;
+                list.push_front(value);
+                if(i%2==0)
+                    list.remove_if([value](int const& v){return v==value;});
+            }
+        });
+    }
+    for(auto& thread:threads)
+        thread.join();
+
+    int count=0;
+    list.for_each([&](int& v){
+        assert(v%2==1);
+        ++count;
+    });
+    assert(count==num_threads*items_per_thread/2);
+}
+
+void test_push_back_operations(){
+    threadsafe_list<int> list;
+    for(int i=0;i<5;++i)
+        list.push_back(i);
+    list.push_front(-1);
+    assert(list.size()==6);
+
+    std::vector<int> order;
+    list.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{-1,0,1,2,3,4}));
+
+    // Removing the last node moves the tail back to its predecessor
+    list.remove_if([](int const& v){return v>=3;});
+    list.push_back(10);
+    order.clear();
+    list.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{-1,0,1,2,10}));
+    assert(list.size()==5);
+
+    // Emptying the list resets the tail to the head
+    list.remove_if([](int const&){return true;});
+    assert(list.size()==0);
+    list.push_back(7);
+    list.push_front(6);
+    list.push_back(8);
+    order.clear();
+    list.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{6,7,8}));
+}
+
+// Appenders race with a thread that repeatedly strips the tail end
+void test_concurrent_push_back(){
+    threadsafe_list<int> list;
+    const int num_threads=4;
+    const int items_per_thread=2000;
+    std::vector<std::thread> threads;
+
+    for(int t=0;t<num_threads;++t){
+        threads.emplace_back([&,t]{
+            for(int i=0;i<items_per_thread;++i)
+                list.push_back(t*items_per_thread+i);
+        });
+    }
+    threads.emplace_back([&]{
+        for(int i=0;i<200;++i)
+            list.remove_if([](int const& v){return v%items_per_thread%10==9;});
+    });
+    for(auto& thread:threads)
+        thread.join();
+    list.remove_if([](int const& v){return v%items_per_thread%10==9;});
+
+    // Each appender's values stay in the order they were appended
+    std::vector<int> last(num_threads,-1);
+    std::size_t count=0;
+    list.for_each([&](int& v){
+        int const t=v/items_per_thread;
+        assert(v>last[t]);
+        last[t]=v;
+        ++count;
+    });
+    assert(count==num_threads*items_per_thread/10*9);
+    assert(list.size()==count);
+}
+
+void test_update_operations(){
+    struct account{
+        int id;
+        long balance;
+    };
+
+    threadsafe_list<account> list;
+    for(int i=0;i<10;++i)
+        list.push_back(account{i,100});
+
+    bool const updated=list.update_first_if([](account const& a){return a.id==3;},
+                                            [](account& a){a.balance+=50;});
+    assert(updated);
+    bool const missing=list.update_first_if([](account const& a){return a.id==42;},
+                                            [](account& a){a.balance=0;});
+    assert(!missing);
+    std::shared_ptr<account> found=list.find_first_if([](account const& a){return a.id==3;});
+    assert(found && found->balance==150);
+
+    std::size_t const count=list.update_all_if([](account const& a){return a.id%2==0;},
+                                               [](account& a){a.balance-=10;});
+    assert(count==5);
+
+    // Concurrent increments of the same elements are never lost
+    const int num_threads=4;
+    const int rounds=1000;
+    std::vector<std::thread> threads;
+    for(int t=0;t<num_threads;++t){
+        threads.emplace_back([&]{
+            for(int i=0;i<rounds;++i){
+                list.update_first_if([](account const& a){return a.id==9;},
+                                     [](account& a){++a.balance;});
+                list.update_all_if([](account const& a){return a.id<2;},
+                                   [](account& a){++a.balance;});
             }
+        });
+    }
+    for(auto& thread:threads)
+        thread.join();
+
+    std::vector<long> balances;
+    list.for_each([&](account& a){balances.push_back(a.balance);});
+    assert((balances==std::vector<long>{90+num_threads*rounds,100+num_threads*rounds,
+                                        90,150,90,100,90,100,90,100+num_threads*rounds}));
+}
+
+void test_visit_operations(){
+    threadsafe_list<std::string> list;
+    for(char const* s:{"alpha","beta","gamma","delta"})
+        list.push_back(s);
+
+    std::optional<std::size_t> length=list.find_first_if_visit(
+        [](std::string const& s){return s[0]=='g';},
+        [](std::string const& s){return s.size();});
+    assert(length && *length==5);
+    std::optional<std::size_t> none=list.find_first_if_visit(
+        [](std::string const& s){return s.empty();},
+        [](std::string const& s){return s.size();});
+    assert(!none);
+
+    // A visitor returning a reference still yields a copy
+    std::optional<std::string> name=list.find_first_if_visit(
+        [](std::string const& s){return s[0]=='b';},
+        [](std::string const& s) -> std::string const& {return s;});
+    assert(name && *name=="beta");
+
+    std::string seen;
+    bool const visited=list.find_first_if_visit([](std::string const& s){return s[0]=='d';},
+                                                [&](std::string const& s){seen=s;});
+    assert(visited && seen=="delta");
+
+    std::optional<std::string> copy=list.find_first_copy([](std::string const& s){return s.size()==4;});
+    assert(copy && *copy=="beta");
+    // The copy is detached from the element in the list
+    list.update_first_if([](std::string const& s){return s=="beta";},[](std::string& s){s="BETA";});
+    assert(*copy=="beta");
+    assert(!list.find_first_copy([](std::string const& s){return s=="beta";}));
+}
+
+// Readers walk with shared node locks while writers update and churn
+void test_shared_operations(){
+    threadsafe_list<int, std::shared_mutex> list;
+    const int stable=500;
+    for(int i=0;i<stable;++i)
+        list.push_back(2*i);
+
+    std::atomic<bool> done(false);
+    bool readers_ok=true;
+    std::mutex readers_mutex;
+    std::vector<std::thread> readers;
+    for(int r=0;r<3;++r){
+        readers.emplace_back([&]{
+            bool ok=true;
+            long iterations=0;
+            while(!done || iterations<10){
+                int evens=0;
+                list.for_each_shared([&](int const& v){
+                    if(v%2==0)
+                        ++evens;
+                });
+                ok=ok && evens==stable;
+                std::optional<int> found=list.find_first_copy([&](int const& v){return v==2*(stable-1);});
+                ok=ok && found && *found==2*(stable-1);
+                ++iterations;
+            }
+            std::lock_guard<std::mutex> lk(readers_mutex);
+            readers_ok=readers_ok && ok;
+        });
+    }
+
+    for(int round=0;round<200;++round){
+        for(int i=0;i<5;++i)
+            list.push_back(2*(round*5+i)+1);
+        list.update_all_if([](int const& v){return v%2==1;},[](int& v){v+=2;});
+        list.remove_if([](int const& v){return v%2==1;});
+    }
+    done=true;
+    for(auto& reader:readers)
+        reader.join();
+    assert(readers_ok);
+    assert(list.size()==static_cast<std::size_t>(stable));
+}
+
+void test_snapshot_operations(){
+    threadsafe_list<int> list;
+    for(int i=0;i<5;++i)
+        list.push_back(i);
+
+    list_snapshot<int> snap=list.snapshot();
+    assert(snap.size()==5);
+
+    // Later writes, including in-place updates, do not show through
+    list.push_front(-1);
+    list.remove_if([](int const& v){return v==2;});
+    list.update_all_if([](int const&){return true;},[](int& v){v*=10;});
+    list.for_each([](int& v){++v;});
+
+    std::vector<int> seen;
+    for(int const& v:snap)
+        seen.push_back(v);
+    assert((seen==std::vector<int>{0,1,2,3,4}));
+
+    std::vector<int> now;
+    for(int const& v:list.snapshot())
+        now.push_back(v);
+    assert((now==std::vector<int>{-9,1,11,31,41}));
+
+    // A parallel walk cannot write through a snapshot either
+    struct inline_executor{
+        void submit(std::function<void()> task){task();}
+    } inline_pool;
+    list_snapshot<int> before=list.snapshot();
+    long sum=0;
+    list.parallel_for_each(inline_pool,[&](int const& v){sum+=v;});
+    list.for_each([](int& v){v+=100;});
+    seen.clear();
+    for(int const& v:before)
+        seen.push_back(v);
+    assert((seen==std::vector<int>{-9,1,11,31,41}));
+    assert(sum==75);
+
+    // find_first_if shares the live element, so it follows in-place updates
+    std::shared_ptr<int> handle=list.find_first_if([](int const& v){return v==101;});
+    list.for_each([](int& v){++v;});
+    assert(handle && *handle==102);
+}
+
+// The writer bumps a counter at the front and only then appends the same
+// sequence number at the back. A walk that let the writer overtake it could
+// see the append without the bump; a snapshot never can
+void test_concurrent_snapshots(){
+    struct entry{
+        bool counter;
+        int sequence;
+    };
+
+    threadsafe_list<entry, std::shared_mutex> list;
+    list.push_front(entry{true,0});
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]{
+        for(int k=1;k<=5000;++k){
+            list.update_first_if([](entry const& e){return e.counter;},[k](entry& e){e.sequence=k;});
+            list.push_back(entry{false,k});
+            if(k%100==0)
+                list.remove_if([k](entry const& e){return !e.counter && e.sequence<k-200;});
+            std::this_thread::yield();
+        }
+        done=true;
+    });
+
+    long snapshots=0;
+    while(!done || snapshots<10){
+        list_snapshot<entry> snap=list.snapshot();
+        int counter=-1,newest=0;
+        for(entry const& e:snap){
+            if(e.counter)
+                counter=e.sequence;
+            else
+                newest=std::max(newest,e.sequence);
+            std::this_thread::yield();
+        }
+        assert(counter>=newest);
+        ++snapshots;
+    }
+    writer.join();
+}
+
+// Minimal executor for the parallel traversal tests.
+class simple_thread_pool{
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::queue<std::function<void()> > tasks;
+    std::vector<std::thread> workers;
+    bool stopping=false;
+
+public:
+    explicit simple_thread_pool(unsigned num_threads){
+        for(unsigned i=0;i<num_threads;++i){
+            workers.emplace_back([this]{
+                for(;;){
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(m);
+                        cv.wait(lk,[this]{return stopping || !tasks.empty();});
+                        if(tasks.empty())
+                            return;
+                        task=std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~simple_thread_pool(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stopping=true;
+        }
+        cv.notify_all();
+        for(auto& worker:workers)
+            worker.join();
+    }
+
+    void submit(std::function<void()> task){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            tasks.push(std::move(task));
         }
+        cv.notify_one();
     }
 };
 
-int main(){}
\ No newline at end of file
+void test_parallel_operations(){
+    threadsafe_list<int> list;
+    simple_thread_pool pool(4);
+    const int num_items=10000;
+    for(int i=0;i<num_items;++i)
+        list.push_front(i);
+
+    std::atomic<long> sum(0);
+    list.parallel_for_each(pool,[&](int const& v){sum+=v;},100);
+    assert(sum==static_cast<long>(num_items)*(num_items-1)/2);
+
+    // Removal runs while another thread keeps adding new elements
+    std::thread writer([&]{
+        for(int i=num_items;i<num_items+1000;++i)
+            list.push_front(i);
+    });
+    list.parallel_remove_if(pool,[](int const& v){return v<num_items && v%2==0;},100);
+    writer.join();
+
+    int count=0;
+    list.for_each([&](int& v){
+        assert(v>=num_items || v%2==1);
+        ++count;
+    });
+    assert(count==num_items/2+1000);
+
+    // Exceptions thrown by f reach the caller
+    bool thrown=false;
+    try{
+        list.parallel_for_each(pool,[](int const& v){if(v==1) throw std::runtime_error("boom");});
+    }catch(std::runtime_error const&){
+        thrown=true;
+    }
+    assert(thrown);
+
+    // An executor that runs tasks on the submitting thread holds no node
+    // lock by then, so f may use the list itself
+    struct inline_executor{
+        void submit(std::function<void()> task){task();}
+    } inline_pool;
+    long matched=0;
+    list.parallel_for_each(inline_pool,[&](int const& v){
+        if(list.find_first_copy([v](int const& w){return w==v;}))
+            ++matched;
+    },100);
+    assert(matched==count);
+}
+
+// benchmarking
+
+void benchmark_push_remove(long cycles){
+    threadsafe_list<long> list;
+    auto const start=std::chrono::steady_clock::now();
+    for(long i=0;i<cycles;++i){
+        list.push_front(i);
+        list.remove_if([i](long const& v){return v==i;});
+    }
+    double const seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    std::cout<<cycles<<" push_front/remove_if cycles: "<<seconds*1e9/cycles<<" ns/cycle"<<std::endl;
+}
+
+// A reader keeps timing full traversals of a short list while a writer
+// keeps adding and removing entries whose payloads are expensive to destroy
+// (thousands of separately allocated strings each). Also reports how long
+// each remove_if call takes, most of which is that destruction.
+void benchmark_traversal_under_removal(int rounds){
+    typedef std::vector<std::string> payload;
+    threadsafe_list<payload> list;
+    for(int i=0;i<64;++i)
+        list.push_front(payload(1,std::to_string(i)));
+    payload const heavy(4096,std::string(64,'x'));
+
+    std::atomic<bool> done(false);
+    double remove_total=0;
+    std::thread writer([&]{
+        for(int round=0;round<rounds;++round){
+            for(int i=0;i<8;++i)
+                list.push_front(heavy);
+            auto const start=std::chrono::steady_clock::now();
+            list.remove_if([](payload const& v){return v.size()>1;});
+            remove_total+=std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count();
+        }
+        done=true;
+    });
+
+    long traversals=0;
+    double total=0,worst=0;
+    while(!done){
+        auto const start=std::chrono::steady_clock::now();
+        std::size_t sum=0;
+        list.for_each_shared([&](payload const& v){sum+=v[0].size();});
+        double const us=std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count();
+        total+=us;
+        worst=std::max(worst,us);
+        ++traversals;
+    }
+    writer.join();
+    std::cout<<traversals<<" traversals under removal: "<<total/traversals<<" us mean, "
+             <<worst<<" us worst; remove_if of 8 heavy payloads: "<<remove_total/rounds<<" us mean"<<std::endl;
+}
+
+// Reader traversals and writer updates per second for a 1000-element list,
+// with exclusive versus shared node locks.
+template<typename Mutex>
+void benchmark_readers_writers(char const* name, int num_readers, int milliseconds){
+    threadsafe_list<int, Mutex> list;
+    const int num_items=1000;
+    for(int i=0;i<num_items;++i)
+        list.push_back(i);
+
+    std::atomic<bool> done(false);
+    std::atomic<long> traversals(0);
+    long updates=0;
+    std::vector<std::thread> readers;
+    for(int r=0;r<num_readers;++r){
+        readers.emplace_back([&]{
+            long local=0;
+            while(!done){
+                long sum=0;
+                list.for_each_shared([&](int const& v){sum+=v;});
+                ++local;
+            }
+            traversals+=local;
+        });
+    }
+
+    auto const start=std::chrono::steady_clock::now();
+    auto const end=start+std::chrono::milliseconds(milliseconds);
+    while(std::chrono::steady_clock::now()<end){
+        int const key=static_cast<int>(updates%num_items);
+        list.update_first_if([key](int const& v){return v==key;},[](int&){});
+        ++updates;
+    }
+    done=true;
+    for(auto& reader:readers)
+        reader.join();
+
+    double const seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    std::cout<<name<<", "<<num_readers<<" readers / 1 writer: "
+             <<traversals/seconds<<" traversals/s, "<<updates/seconds<<" updates/s"<<std::endl;
+}
+
+int main(int argc, char* argv[]){
+    test_sequential_operations();
+    test_concurrent_operations();
+    test_parallel_operations();
+    test_push_back_operations();
+    test_concurrent_push_back();
+    test_update_operations();
+    test_visit_operations();
+    test_shared_operations();
+    test_snapshot_operations();
+    test_concurrent_snapshots();
+    std::cout<<"All tests passed!"<<std::endl;
+
+    benchmark_push_remove(argc>1 ? std::atol(argv[1]) : 10000000);
+    benchmark_traversal_under_removal(argc>1 ? static_cast<int>(std::atol(argv[1])/10000) : 1000);
+    for(int readers:{1,2,4,8}){
+        benchmark_readers_writers<std::mutex>("std::mutex", readers, 200);
+        benchmark_readers_writers<std::shared_mutex>("std::shared_mutex", readers, 200);
+    }
+    return 0;
+}
+
+#endif
@@ -6,57 +6,232 @@
 #include <utility>
 #include<map>
 #include <shared_mutex>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define LOOKUP_TABLE_HAVE_MALLINFO2 1
+#endif
 
+// The table grows once size() exceeds max_load_factor * bucket_count(). A
+// growth step only publishes a new, empty bucket array under a brief
+// exclusive lock. After that, every mutating call moves at most
+// migration_batch buckets into it. Until a key's old bucket has moved, the
+// old bucket stays authoritative for that key. Once all buckets have moved,
+// later calls free the emptied old buckets in the same bounded way. No
+// single call ever rehashes the whole table.
 template<typename Key, typename Value, typename Hash = std::hash<Key> >
 class threadsafe_lookup_table{
 private:
+    static constexpr std::size_t migration_batch = 4;
+
     class bucket_type{
     private:
         typedef std::pair<Key, Value> bucket_value;
         typedef std::list<bucket_value> bucket_data;
         typedef typename bucket_data::iterator bucket_iterator;
+        typedef typename bucket_data::const_iterator bucket_const_iterator;
 
         bucket_data data;
         mutable std::shared_mutex mutex;
+        // Set under mutex once the entries have moved to the next table.
+        bool migrated = false;
 
-        bucket_iterator find_entry_for(Key const& key) const{
-            return std::find_if(data.begin(), data.end(), 
-            [&](bucket_value const item){
+        bucket_iterator find_entry_for(Key const& key){
+            return std::find_if(data.begin(), data.end(),
+            [&](bucket_value const& item){
                 return item.first == key;
             });
         }
 
+        bucket_const_iterator find_entry_for(Key const& key) const{
+            return std::find_if(data.begin(), data.end(),
+            [&](bucket_value const& item){
+                return item.first == key;
+            });
+        }
+
+        friend class threadsafe_lookup_table;
+
     public:
-        Value value_for(Key const& key, Value const& default_value) const{
+        // Each of these returns false, doing nothing, once the bucket has
+        // migrated; the caller then retries on the new table.
+        bool value_for(Key const& key, Value const& default_value, Value& result) const{
             std::shared_lock<std::shared_mutex> lock(mutex);
-            bucket_iterator const found_entry = find_entry_for(key);
-            return (found_entry == data.end()) ? default_value : found_entry -> second;
+            if(migrated)
+                return false;
+            bucket_const_iterator const found_entry = find_entry_for(key);
+            result = (found_entry == data.end()) ? default_value : found_entry -> second;
+            return true;
         }
 
-        void add_or_update_mapping(Key const& key, Value const& value){
+        bool add_or_update_mapping(Key const& key, Value const& value, bool& inserted){
             std::unique_lock<std::shared_mutex> lock(mutex);
+            if(migrated)
+                return false;
             bucket_iterator const found_entry = find_entry_for(key);
-            if(found_entry == data.end()){
+            inserted = (found_entry == data.end());
+            if(inserted){
                 data.push_back(bucket_value(key, value));
             }else{
                 found_entry -> second = value;
             }
+            return true;
         }
 
-        void remove_mapping(Key const& key){
+        bool remove_mapping(Key const& key, bool& removed){
             std::unique_lock<std::shared_mutex> lock(mutex);
+            if(migrated)
+                return false;
             bucket_iterator const found_entry = find_entry_for(key);
-            if(found_entry != data.end())
+            removed = (found_entry != data.end());
+            if(removed)
                 data.erase(found_entry);
+            return true;
         }
     };
 
-    std::vector<std::unique_ptr<bucket_type> > buckets;
+    // Buckets are created on first use, so publishing a larger table costs
+    // one zeroed pointer array rather than a bucket object per slot. calloc
+    // lets large arrays come straight from fresh zero pages.
+    class table{
+    private:
+        struct free_deleter{
+            void operator()(void* p) const{ std::free(p); }
+        };
+
+        std::unique_ptr<std::atomic<bucket_type*>[], free_deleter> buckets;
+
+    public:
+        std::size_t const size;
+        // Set once every bucket has been freed through free_bucket.
+        bool drained = false;
+
+        explicit table(std::size_t size_) :
+            buckets(static_cast<std::atomic<bucket_type*>*>(std::calloc(size_, sizeof(std::atomic<bucket_type*>)))),
+            size(size_){
+            if(!buckets)
+                throw std::bad_alloc();
+        }
+
+        ~table(){
+            if(drained)
+                return;
+            for(std::size_t i = 0; i < size; ++i)
+                delete buckets[i].load(std::memory_order_relaxed);
+        }
+
+        bucket_type& bucket(std::size_t index){
+            bucket_type* existing = buckets[index].load(std::memory_order_acquire);
+            if(existing)
+                return *existing;
+            std::unique_ptr<bucket_type> created(new bucket_type);
+            if(buckets[index].compare_exchange_strong(existing, created.get(), std::memory_order_acq_rel))
+                return *created.release();
+            return *existing;
+        }
+
+        bucket_type* existing_bucket(std::size_t index) const{
+            return buckets[index].load(std::memory_order_acquire);
+        }
+
+        void free_bucket(std::size_t index){
+            delete buckets[index].exchange(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    // resize_mutex is held shared by every operation and exclusively only to
+    // switch phases. previous is non-null while its buckets are migrating;
+    // draining holds a fully migrated table whose buckets are being freed.
+    mutable std::shared_mutex resize_mutex;
+    std::unique_ptr<table> current;
+    std::unique_ptr<table> previous;
+    std::unique_ptr<table> draining;
+    std::atomic<std::size_t> cursor;
+    std::atomic<std::size_t> finished;
+    std::atomic<std::size_t> count;
+    float const max_load_factor;
     Hash hasher;
 
-    bucket_type& get_bucket(Key const& key) const {
-        std::size_t const bucket_index = hasher(key) % buckets.size();
-        return *buckets[bucket_index];
+    // Runs f on the bucket that currently owns key. Needs resize_mutex held
+    // at least shared.
+    template<typename Function>
+    void with_bucket(Key const& key, Function f) const{
+        std::size_t const hash = hasher(key);
+        if(previous && f(previous -> bucket(hash % previous -> size)))
+            return;
+        f(current -> bucket(hash % current -> size));
+    }
+
+    void migrate_bucket(std::size_t index){
+        bucket_type& old_bucket = previous -> bucket(index);
+        std::unique_lock<std::shared_mutex> old_lock(old_bucket.mutex);
+        while(!old_bucket.data.empty()){
+            auto const entry = old_bucket.data.begin();
+            bucket_type& new_bucket = current -> bucket(hasher(entry -> first) % current -> size);
+            std::unique_lock<std::shared_mutex> new_lock(new_bucket.mutex);
+            new_bucket.data.splice(new_bucket.data.end(), old_bucket.data, entry);
+        }
+        old_bucket.migrated = true;
+    }
+
+    // Does a bounded slice of the pending resize work. Returns true when the
+    // current phase is complete and needs switching. Needs resize_mutex held
+    // shared.
+    bool help_resize(){
+        table* const source = previous ? previous.get() : draining.get();
+        if(!source)
+            return false;
+        for(std::size_t i = 0; i < migration_batch; ++i){
+            std::size_t const index = cursor.fetch_add(1);
+            if(index >= source -> size)
+                return false;
+            if(previous)
+                migrate_bucket(index);
+            else
+                source -> free_bucket(index);
+            if(finished.fetch_add(1) + 1 == source -> size)
+                return true;
+        }
+        return false;
+    }
+
+    void next_phase(){
+        std::unique_ptr<table> released;
+        {
+            std::unique_lock<std::shared_mutex> lock(resize_mutex);
+            table* const source = previous ? previous.get() : draining.get();
+            if(!source || finished.load() != source -> size)
+                return;
+            if(previous){
+                draining = std::move(previous);
+            }else{
+                // Only the pointer array is left to free.
+                draining -> drained = true;
+                released = std::move(draining);
+            }
+            cursor.store(0);
+            finished.store(0);
+        }
+    }
+
+    void maybe_grow(){
+        std::unique_lock<std::shared_mutex> lock(resize_mutex);
+        if(previous || draining || count.load() <= max_load_factor * current -> size)
+            return;
+        previous = std::move(current);
+        current.reset(new table(previous -> size * 2 + 1));
+        cursor.store(0);
+        finished.store(0);
     }
 
 public:
@@ -64,37 +239,82 @@ public:
     typedef Value mapped_type;
     typedef Hash hash_type;
 
-    threadsafe_lookup_table(unsigned num_buckets = 19, Hash const& hasher_ = Hash()) :
-        buckets(num_buckets), hasher(hasher_){
-            for(unsigned i = 0; i < num_buckets; ++i)
-                buckets[i].reset(new bucket_type);
+    threadsafe_lookup_table(unsigned num_buckets = 19, Hash const& hasher_ = Hash(), float max_load_factor_ = 1.0f) :
+        current(new table(std::max(num_buckets, 1u))), cursor(0), finished(0), count(0),
+        max_load_factor(max_load_factor_), hasher(hasher_){
     }
 
     threadsafe_lookup_table(threadsafe_lookup_table const& other) = delete;
     threadsafe_lookup_table& operator=(threadsafe_lookup_table const& other) = delete;
 
     Value value_for(Key const& key, Value const& default_value = Value()) const{
-        return get_bucket(key).value_for(key, default_value);
+        std::shared_lock<std::shared_mutex> lock(resize_mutex);
+        Value result = default_value;
+        with_bucket(key, [&](bucket_type& bucket){
+            return bucket.value_for(key, default_value, result);
+        });
+        return result;
     }
 
     void add_or_update_mapping(Key const& key, Value const& value){
-        get_bucket(key).add_or_update_mapping(key, value);
+        bool inserted = false;
+        bool phase_done;
+        {
+            std::shared_lock<std::shared_mutex> lock(resize_mutex);
+            with_bucket(key, [&](bucket_type& bucket){
+                return bucket.add_or_update_mapping(key, value, inserted);
+            });
+            if(inserted)
+                ++count;
+            phase_done = help_resize();
+        }
+        if(phase_done)
+            next_phase();
+        else if(inserted && count.load() > max_load_factor * bucket_count())
+            maybe_grow();
     }
 
     void remove_mapping(Key const& key){
-        get_bucket(key).remove_mapping(key);
+        bool removed = false;
+        bool phase_done;
+        {
+            std::shared_lock<std::shared_mutex> lock(resize_mutex);
+            with_bucket(key, [&](bucket_type& bucket){
+                return bucket.remove_mapping(key, removed);
+            });
+            if(removed)
+                --count;
+            phase_done = help_resize();
+        }
+        if(phase_done)
+            next_phase();
+    }
+
+    std::size_t size() const{
+        return count.load();
+    }
+
+    // Buckets of the newest table.
+    std::size_t bucket_count() const{
+        std::shared_lock<std::shared_mutex> lock(resize_mutex);
+        return current -> size;
     }
 
     std::map<Key, Value> get_map() const {
-        std::vector<std::unique_lock<std::shared_mutex>> locks;
-        for(unsigned i = 0; i < buckets.size(); ++i)
-            locks.push_back(std::unique_lock<std::shared_mutex>(buckets[i]->mutex));
-    
+        // Excluding every other operation also keeps the buckets still
+        // waiting to migrate stable.
+        std::unique_lock<std::shared_mutex> lock(resize_mutex);
         std::map<Key, Value> res;
-
-        for(unsigned i = 0; i < buckets.size(); ++i){
-            for(typename bucket_type::bucket_iterator it = buckets[i]->data.begin(); it != buckets[i]->data.end(); ++it){
-                res.emplace(it->first, it->second);
+        for(table const* t : {previous.get(), current.get()}){
+            if(!t)
+                continue;
+            for(std::size_t i = 0; i < t -> size; ++i){
+                bucket_type const* const bucket = t -> existing_bucket(i);
+                if(!bucket || bucket -> migrated)
+                    continue;
+                for(auto it = bucket -> data.begin(); it != bucket -> data.end(); ++it){
+                    res.emplace(it->first, it->second);
+                }
             }
         }
 
@@ -103,6 +323,603 @@ public:
 
 };
 
-int main(){
+// Flat alternative to threadsafe_lookup_table with the same interface.
+// Entries live in contiguous open-addressed arrays, one per lock stripe, so a
+// lookup probes adjacent slots instead of chasing list nodes. Probing is
+// Robin Hood: an insert takes the slot of any entry that sits closer to its
+// home slot, and erase shifts the following entries back. Probe sequences
+// therefore stay short without tombstones. Each stripe grows on its own once
+// it is seven eighths full. Like the list buckets above, the old array is
+// kept and drained by later writes to that stripe, migration_batch slots at
+// a time, so no single call rehashes a whole stripe.
+template<typename Key, typename Value, typename Hash = std::hash<Key> >
+class threadsafe_flat_lookup_table{
+private:
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t initial_stripe_capacity = 8;
+    static constexpr std::size_t migration_batch = 16;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    // Left in an old array's slot once its entry has moved. Real tags are
+    // odd, so this never matches one.
+    static constexpr std::uint32_t moved_tag = 2;
+
+    typedef std::pair<Key, Value> slot_value;
+
+    // Each slot keeps 32 bits of its key's hash, with the low bit set so
+    // that 0 can mark a free slot. The tag gives the home slot, so probe
+    // distances and rehashing need no call to Hash, and most mismatching
+    // keys are rejected without comparing them. As with the list table's
+    // bucket array, the tags come from calloc and the slots are left
+    // unconstructed until used, so allocating a large array touches no
+    // memory up front.
+    class probe_table{
+    private:
+        struct free_deleter{
+            void operator()(void* p) const{ std::free(p); }
+        };
+        typedef typename std::aligned_storage<sizeof(slot_value), alignof(slot_value)>::type slot_storage;
+
+        std::unique_ptr<std::uint32_t[], free_deleter> tag_array;
+        std::unique_ptr<slot_storage[]> slot_array;
+
+    public:
+        std::size_t const capacity;
+        // Set once every entry has moved out, so nothing is left to destroy.
+        bool drained = false;
+
+        explicit probe_table(std::size_t capacity_) :
+            tag_array(static_cast<std::uint32_t*>(std::calloc(capacity_, sizeof(std::uint32_t)))),
+            slot_array(new slot_storage[capacity_]),
+            capacity(capacity_){
+            if(!tag_array)
+                throw std::bad_alloc();
+        }
+
+        ~probe_table(){
+            if(drained || std::is_trivially_destructible<slot_value>::value)
+                return;
+            for(std::size_t i = 0; i < capacity; ++i){
+                if(tag_array[i] & 1)
+                    slot(i).~slot_value();
+            }
+        }
+
+        probe_table(probe_table const& other) = delete;
+        probe_table& operator=(probe_table const& other) = delete;
+
+        std::uint32_t& tag(std::size_t index){
+            return tag_array[index];
+        }
+
+        std::uint32_t tag(std::size_t index) const{
+            return tag_array[index];
+        }
+
+        slot_value& slot(std::size_t index){
+            return *std::launder(reinterpret_cast<slot_value*>(&slot_array[index]));
+        }
+
+        slot_value const& slot(std::size_t index) const{
+            return *std::launder(reinterpret_cast<slot_value const*>(&slot_array[index]));
+        }
+
+        std::size_t mask() const{
+            return capacity - 1;
+        }
+
+        std::size_t home(std::uint32_t tag) const{
+            return (tag >> 1) & mask();
+        }
+
+        std::size_t distance(std::size_t index) const{
+            return (index - home(tag(index))) & mask();
+        }
+
+        // Moved slots only occur in an array being drained, which takes no
+        // more inserts, so the entries left in it keep the Robin Hood order
+        // and the early exit stays valid once the moved slots are skipped.
+        std::size_t find(Key const& key, std::uint32_t key_tag) const{
+            std::size_t index = home(key_tag);
+            for(std::size_t probes = 0; tag(index) != 0; ++probes){
+                if(tag(index) != moved_tag){
+                    if(distance(index) < probes)
+                        break;
+                    if(tag(index) == key_tag && slot(index).first == key)
+                        return index;
+                }
+                index = (index + 1) & mask();
+            }
+            return npos;
+        }
+
+        // Places an entry known to be absent; needs a free slot.
+        void place(slot_value entry, std::uint32_t entry_tag){
+            std::size_t index = home(entry_tag);
+            for(std::size_t probes = 0;; ++probes){
+                if(tag(index) == 0){
+                    tag(index) = entry_tag;
+                    new (&slot_array[index]) slot_value(std::move(entry));
+                    return;
+                }
+                std::size_t const resident = distance(index);
+                if(resident < probes){
+                    std::swap(tag(index), entry_tag);
+                    std::swap(slot(index), entry);
+                    probes = resident;
+                }
+                index = (index + 1) & mask();
+            }
+        }
+
+        void erase_at(std::size_t index){
+            std::size_t next = (index + 1) & mask();
+            while(tag(next) != 0 && distance(next) != 0){
+                tag(index) = tag(next);
+                slot(index) = std::move(slot(next));
+                index = next;
+                next = (next + 1) & mask();
+            }
+            tag(index) = 0;
+            slot(index).~slot_value();
+        }
+
+        // For an array being drained: empties the slot without shifting.
+        void mark_moved(std::size_t index){
+            tag(index) = moved_tag;
+            slot(index).~slot_value();
+        }
+    };
+
+    struct alignas(cache_line_size) stripe_type{
+        mutable std::shared_mutex mutex;
+        std::unique_ptr<probe_table> current;
+        // The array current replaced, while its entries are still moving;
+        // slots below cursor have moved.
+        std::unique_ptr<probe_table> previous;
+        std::size_t cursor = 0;
+        // Entries in both arrays.
+        std::size_t count = 0;
+
+        stripe_type() : current(new probe_table(initial_stripe_capacity)){}
+
+        slot_value const* find(Key const& key, std::uint32_t tag) const{
+            std::size_t index = current -> find(key, tag);
+            if(index != npos)
+                return &current -> slot(index);
+            if(!previous)
+                return nullptr;
+            index = previous -> find(key, tag);
+            return index == npos ? nullptr : &previous -> slot(index);
+        }
+
+        slot_value* find(Key const& key, std::uint32_t tag){
+            return const_cast<slot_value*>(static_cast<stripe_type const&>(*this).find(key, tag));
+        }
+
+        void insert(slot_value entry, std::uint32_t tag){
+            if((count + 1) * 8 > current -> capacity * 7)
+                grow();
+            current -> place(std::move(entry), tag);
+            ++count;
+        }
+
+        bool erase(Key const& key, std::uint32_t tag){
+            std::size_t index = current -> find(key, tag);
+            if(index != npos){
+                current -> erase_at(index);
+            }else{
+                if(!previous || (index = previous -> find(key, tag)) == npos)
+                    return false;
+                previous -> mark_moved(index);
+            }
+            --count;
+            return true;
+        }
+
+        // Moves the next migration_batch slots of previous into current.
+        void migrate_step(){
+            if(!previous)
+                return;
+            std::size_t const end = std::min(cursor + migration_batch, previous -> capacity);
+            for(; cursor < end; ++cursor){
+                std::uint32_t const tag = previous -> tag(cursor);
+                if(tag & 1){
+                    current -> place(std::move(previous -> slot(cursor)), tag);
+                    previous -> mark_moved(cursor);
+                }
+            }
+            if(cursor == previous -> capacity){
+                previous -> drained = true;
+                previous.reset();
+                cursor = 0;
+            }
+        }
+
+        // Doubling leaves at least capacity * 7 / 8 inserts before the next
+        // grow, far more than the capacity / migration_batch writes that
+        // drain previous, so the loop below only guards the invariant.
+        void grow(){
+            while(previous)
+                migrate_step();
+            std::unique_ptr<probe_table> larger(new probe_table(current -> capacity * 2));
+            previous = std::move(current);
+            current = std::move(larger);
+            cursor = 0;
+        }
+    };
+
+    std::vector<stripe_type> stripes;
+    unsigned const stripe_bits;
+    Hash hasher;
+
+    // Spreads the user hash so that both the stripe (top bits) and the tag
+    // (low bits) vary even for identity hashes of small integers.
+    std::uint64_t mixed_hash(Key const& key) const{
+        std::uint64_t const h = static_cast<std::uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 32);
+    }
+
+    static std::uint32_t tag_of(std::uint64_t hash){
+        return static_cast<std::uint32_t>(hash) | 1u;
+    }
+
+    std::size_t stripe_index(std::uint64_t hash) const{
+        return stripe_bits == 0 ? 0 : static_cast<std::size_t>(hash >> (64 - stripe_bits));
+    }
+
+    static unsigned bits_for(unsigned num_stripes){
+        unsigned bits = 0;
+        while((1u << bits) < num_stripes)
+            ++bits;
+        return bits;
+    }
+
+public:
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef Hash hash_type;
+
+    // num_stripes is rounded up to a power of two.
+    threadsafe_flat_lookup_table(unsigned num_stripes = 64, Hash const& hasher_ = Hash()) :
+        stripes(std::size_t(1) << bits_for(num_stripes)), stripe_bits(bits_for(num_stripes)), hasher(hasher_){
+    }
+
+    threadsafe_flat_lookup_table(threadsafe_flat_lookup_table const& other) = delete;
+    threadsafe_flat_lookup_table& operator=(threadsafe_flat_lookup_table const& other) = delete;
+
+    Value value_for(Key const& key, Value const& default_value = Value()) const{
+        std::uint64_t const hash = mixed_hash(key);
+        stripe_type const& stripe = stripes[stripe_index(hash)];
+        std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+        slot_value const* const found = stripe.find(key, tag_of(hash));
+        return found ? found -> second : default_value;
+    }
+
+    void add_or_update_mapping(Key const& key, Value const& value){
+        std::uint64_t const hash = mixed_hash(key);
+        std::uint32_t const tag = tag_of(hash);
+        stripe_type& stripe = stripes[stripe_index(hash)];
+        std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+        stripe.migrate_step();
+        if(slot_value* const found = stripe.find(key, tag)){
+            found -> second = value;
+            return;
+        }
+        stripe.insert(slot_value(key, value), tag);
+    }
+
+    void remove_mapping(Key const& key){
+        std::uint64_t const hash = mixed_hash(key);
+        stripe_type& stripe = stripes[stripe_index(hash)];
+        std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+        stripe.migrate_step();
+        stripe.erase(key, tag_of(hash));
+    }
+
+    std::size_t size() const{
+        std::size_t total = 0;
+        for(stripe_type const& stripe : stripes){
+            std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+            total += stripe.count;
+        }
+        return total;
+    }
+
+    std::size_t slot_count() const{
+        std::size_t total = 0;
+        for(stripe_type const& stripe : stripes){
+            std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+            total += stripe.current -> capacity;
+        }
+        return total;
+    }
+
+    std::map<Key, Value> get_map() const{
+        std::vector<std::shared_lock<std::shared_mutex> > locks;
+        for(stripe_type const& stripe : stripes)
+            locks.emplace_back(stripe.mutex);
+
+        std::map<Key, Value> res;
+        for(stripe_type const& stripe : stripes){
+            for(probe_table const* t : {stripe.current.get(), stripe.previous.get()}){
+                if(!t)
+                    continue;
+                for(std::size_t i = 0; i < t -> capacity; ++i){
+                    if(t -> tag(i) & 1)
+                        res.emplace(t -> slot(i).first, t -> slot(i).second);
+                }
+            }
+        }
+        return res;
+    }
+};
+
+// testing
+
+void test_sequential_operations(){
+    threadsafe_lookup_table<int, int> table(3);
+    for(int i = 0; i < 1000; ++i)
+        table.add_or_update_mapping(i, i * 10);
+    assert(table.size() == 1000);
+    assert(table.bucket_count() > 3);
+
+    for(int i = 0; i < 1000; ++i)
+        assert(table.value_for(i, -1) == i * 10);
+    assert(table.value_for(1000, -1) == -1);
+
+    table.add_or_update_mapping(5, 55);
+    assert(table.value_for(5) == 55);
+    assert(table.size() == 1000);
+
+    for(int i = 0; i < 1000; i += 2)
+        table.remove_mapping(i);
+    assert(table.size() == 500);
+
+    std::map<int, int> const contents = table.get_map();
+    assert(contents.size() == 500);
+    for(auto const& item : contents)
+        assert(item.first % 2 == 1 && item.second == (item.first == 5 ? 55 : item.first * 10));
+}
+
+// Writers grow the table through several resizes while readers check that
+// keys which are never touched again stay visible throughout
+void test_concurrent_operations(){
+    threadsafe_lookup_table<int, int> table(7);
+    const int stable_keys = 500;
+    const int num_writers = 4;
+    const int keys_per_writer = 20000;
+    for(int i = 0; i < stable_keys; ++i)
+        table.add_or_update_mapping(-1 - i, i);
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> readers_ok(true);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_writers; ++t){
+        threads.emplace_back([&, t]{
+            for(int i = 0; i < keys_per_writer; ++i){
+                int const key = t * keys_per_writer + i;
+                table.add_or_update_mapping(key, key);
+                if(i % 3 == 0)
+                    table.remove_mapping(key);
+            }
+        });
+    }
+    for(int r = 0; r < 2; ++r){
+        threads.emplace_back([&]{
+            while(!done){
+                for(int i = 0; i < stable_keys; i += 7){
+                    if(table.value_for(-1 - i, -1) != i)
+                        readers_ok = false;
+                }
+            }
+        });
+    }
+    for(int t = 0; t < num_writers; ++t)
+        threads[t].join();
+    done = true;
+    for(std::size_t t = num_writers; t < threads.size(); ++t)
+        threads[t].join();
+
+    assert(readers_ok);
+    std::size_t const expected = stable_keys + num_writers * (keys_per_writer - (keys_per_writer + 2) / 3);
+    assert(table.size() == expected);
+    assert(table.get_map().size() == expected);
+    assert(table.bucket_count() * 2 >= expected);
+}
+
+void test_flat_operations(){
+    threadsafe_flat_lookup_table<std::string, int> table(4);
+    for(int i = 0; i < 2000; ++i)
+        table.add_or_update_mapping(std::to_string(i), i);
+    assert(table.size() == 2000);
+    assert(table.slot_count() * 7 >= table.size() * 8);
+
+    table.add_or_update_mapping("5", 55);
+    assert(table.value_for("5") == 55);
+    assert(table.value_for("2000", -1) == -1);
+    assert(table.size() == 2000);
+
+    // Erasing shifts later entries of a probe sequence back; all must stay
+    // reachable
+    for(int i = 0; i < 2000; i += 3)
+        table.remove_mapping(std::to_string(i));
+    table.remove_mapping("missing");
+    for(int i = 0; i < 2000; ++i){
+        int const expected = i % 3 == 0 ? -1 : (i == 5 ? 55 : i);
+        assert(table.value_for(std::to_string(i), -1) == expected);
+    }
+
+    std::map<std::string, int> const contents = table.get_map();
+    assert(contents.size() == table.size());
+    assert(contents.size() == 2000 - 667);
+
+    // A single stripe and a constant hash put every key in one probe sequence
+    threadsafe_flat_lookup_table<int, int, std::function<std::size_t(int)> > collisions(1, [](int){return std::size_t(42);});
+    for(int i = 0; i < 300; ++i)
+        collisions.add_or_update_mapping(i, i);
+    for(int i = 0; i < 300; i += 2)
+        collisions.remove_mapping(i);
+    for(int i = 0; i < 300; ++i)
+        assert(collisions.value_for(i, -1) == (i % 2 ? i : -1));
+
+    // Updates and erases right after each grow hit keys still waiting in
+    // the old array
+    threadsafe_flat_lookup_table<int, int> growing(1);
+    std::map<int, int> model;
+    for(int i = 0; i < 5000; ++i){
+        growing.add_or_update_mapping(i, i);
+        model[i] = i;
+        if(i >= 7){
+            growing.add_or_update_mapping(i - 7, -i);
+            model[i - 7] = -i;
+        }
+        if(i % 5 == 0){
+            growing.remove_mapping(i - 3);
+            model.erase(i - 3);
+        }
+    }
+    assert(growing.get_map() == model);
+    for(int i = -3; i < 5000; ++i)
+        assert(growing.value_for(i, 1) == (model.count(i) ? model[i] : 1));
+    assert(growing.get_map().size() == growing.size());
+}
+
+void test_flat_concurrent_operations(){
+    threadsafe_flat_lookup_table<int, int> table(8);
+    const int stable_keys = 500;
+    const int num_writers = 4;
+    const int keys_per_writer = 20000;
+    for(int i = 0; i < stable_keys; ++i)
+        table.add_or_update_mapping(-1 - i, i);
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> readers_ok(true);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_writers; ++t){
+        threads.emplace_back([&, t]{
+            for(int i = 0; i < keys_per_writer; ++i){
+                int const key = t * keys_per_writer + i;
+                table.add_or_update_mapping(key, key);
+                if(i % 3 == 0)
+                    table.remove_mapping(key);
+            }
+        });
+    }
+    for(int r = 0; r < 2; ++r){
+        threads.emplace_back([&]{
+            while(!done){
+                for(int i = 0; i < stable_keys; i += 7){
+                    if(table.value_for(-1 - i, -1) != i)
+                        readers_ok = false;
+                }
+            }
+        });
+    }
+    for(int t = 0; t < num_writers; ++t)
+        threads[t].join();
+    done = true;
+    for(std::size_t t = num_writers; t < threads.size(); ++t)
+        threads[t].join();
+
+    assert(readers_ok);
+    std::size_t const expected = stable_keys + num_writers * (keys_per_writer - (keys_per_writer + 2) / 3);
+    assert(table.size() == expected);
+    assert(table.get_map().size() == expected);
+}
+
+// benchmarking
+
+// Heap bytes in use, for the bytes-per-entry comparison below. Only glibc
+// reports it; elsewhere the figure is left out.
+#ifdef LOOKUP_TABLE_HAVE_MALLINFO2
+bool const heap_stats_available = true;
+
+std::size_t heap_in_use(){
+    struct mallinfo2 const info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+#else
+bool const heap_stats_available = false;
+
+std::size_t heap_in_use(){
+    return 0;
+}
+#endif
+
+// Fills each table with num_keys int keys, then reports the mean insert and
+// lookup cost and the heap bytes the table holds per entry.
+template<typename Table>
+void benchmark_backend(char const* name, Table& table, int num_keys){
+    std::size_t const heap_before = heap_in_use();
+    auto const start = std::chrono::steady_clock::now();
+    for(int i = 0; i < num_keys; ++i)
+        table.add_or_update_mapping(i, i);
+    double const insert_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / num_keys;
+    double const bytes_per_entry = double(heap_in_use() - heap_before) / num_keys;
 
-}
\ No newline at end of file
+    long sum = 0;
+    auto const lookup_start = std::chrono::steady_clock::now();
+    for(int i = 0; i < num_keys; ++i)
+        sum += table.value_for(int((i * 7919L) % num_keys));
+    double const lookup_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - lookup_start).count() / num_keys;
+
+    std::cout << "  " << name << ": insert " << insert_ns << " ns, lookup " << lookup_ns << " ns";
+    if(heap_stats_available)
+        std::cout << ", " << bytes_per_entry << " bytes/entry";
+    std::cout << " (" << sum << ")" << std::endl;
+}
+
+void benchmark_backends(int num_keys){
+    std::cout << num_keys << " int keys" << std::endl;
+    {
+        threadsafe_lookup_table<int, int> table;
+        benchmark_backend("list buckets", table, num_keys);
+    }
+    {
+        threadsafe_flat_lookup_table<int, int> table;
+        benchmark_backend("flat stripes", table, num_keys);
+    }
+}
+
+
+// Inserts num_keys keys into a table that starts at its default size and
+// reports the mean and worst single insert, then the mean lookup.
+template<typename Table>
+void benchmark_growth(char const* name, int num_keys){
+    Table table;
+    double worst = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for(int i = 0; i < num_keys; ++i){
+        auto const op_start = std::chrono::steady_clock::now();
+        table.add_or_update_mapping(i, i);
+        worst = std::max(worst, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - op_start).count());
+    }
+    double const insert_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / num_keys;
+
+    long sum = 0;
+    auto const lookup_start = std::chrono::steady_clock::now();
+    for(int i = 0; i < num_keys; ++i)
+        sum += table.value_for(int((i * 7919L) % num_keys));
+    double const lookup_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - lookup_start).count() / num_keys;
+
+    std::cout << name << ", " << num_keys << " keys: insert " << insert_ns
+              << " ns mean, " << worst << " us worst; lookup " << lookup_ns << " ns (" << sum << ")" << std::endl;
+}
+
+int main(int argc, char* argv[]){
+    test_sequential_operations();
+    test_concurrent_operations();
+    test_flat_operations();
+    test_flat_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    int const num_keys = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    if(num_keys <= 0){
+        std::cerr << "usage: " << argv[0] << " [num_keys > 0]" << std::endl;
+        return 1;
+    }
+    benchmark_growth<threadsafe_lookup_table<int, int> >("list buckets", num_keys);
+    benchmark_growth<threadsafe_flat_lookup_table<int, int> >("flat stripes", num_keys);
+    benchmark_backends(num_keys);
+    return 0;
+}
@@ -6,6 +6,23 @@
 #include <vector>
 #include <chrono>
 #include <unordered_set>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Shared wake-up point for a consumer selecting over several queues.
+// Every push on an attached queue bumps the counter, so a selector that
+// found all queues empty can sleep without missing a push.
+struct queue_select_waiter {
+    std::mutex m;
+    std::condition_variable cond;
+    unsigned long signals = 0;
+};
+
+template<typename T>
+class queue_selector;
 
 template<typename T>
 class threadsafe_queue {
@@ -15,13 +32,41 @@ private:
         std::unique_ptr<node> next;
     };
 
-    std::mutex head_mutex;
-    std::mutex tail_mutex;
+    // Build with THREADSAFE_QUEUE_UNPADDED to pack the members together
+    // again, e.g. to compare the two layouts with benchmark_false_sharing.
+#if defined(THREADSAFE_QUEUE_UNPADDED)
+    static constexpr std::size_t cache_line_size = alignof(std::max_align_t);
+#elif defined(__cpp_lib_hardware_interference_size)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+    static constexpr std::size_t cache_line_size = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+    static constexpr std::size_t cache_line_size = 64;
+#endif
+
+    // Consumer and producer state sit on separate cache lines, so producers
+    // taking tail_mutex do not keep invalidating the line consumers spin on.
+    alignas(cache_line_size) std::mutex head_mutex;
     std::unique_ptr<node> head;
+
+    alignas(cache_line_size) std::mutex tail_mutex;
     node* tail;
-    std::condition_variable data_cond;
+
+    alignas(cache_line_size) std::condition_variable data_cond;
+
+    alignas(cache_line_size) std::mutex waiters_mutex;
+    std::vector<queue_select_waiter*> waiters;
+    std::atomic<std::size_t> waiter_count{0};
 
     node* get_tail();
+    void attach_waiter(queue_select_waiter* waiter);
+    void detach_waiter(queue_select_waiter* waiter);
+    void notify_waiters();
     std::unique_ptr<node> pop_head();
     
     std::unique_lock<std::mutex> wait_for_data();
@@ -29,6 +74,8 @@ private:
     std::unique_ptr<node> wait_pop_head(T& value);
     std::unique_ptr<node> try_pop_head();
     std::unique_ptr<node> try_pop_head(T& value);
+    std::unique_ptr<node> pop_head_batch(std::size_t max_items, std::size_t& count);
+    static void append_batch(std::unique_ptr<node> batch, std::vector<T>& out);
 
 public:
     threadsafe_queue();
@@ -40,8 +87,40 @@ public:
     bool try_pop(T& value);
     std::shared_ptr<T> wait_and_pop();
     void wait_and_pop(T& value);
+    template<typename Rep, typename Period>
+    std::size_t wait_pop_batch(std::vector<T>& out, std::size_t max_items, std::chrono::duration<Rep, Period> const& linger);
     void push(T new_value);
     bool empty();
+
+    friend class queue_selector<T>;
+};
+
+// Blocks on a set of queues and pops from the first one that has data.
+// With policy::priority the queues are scanned in the order given, so index 0
+// always wins when several are ready; policy::round_robin rotates the start
+// to keep a busy queue from starving the others.
+// The selector must not outlive the queues it was built from.
+template<typename T>
+class queue_selector {
+public:
+    enum class policy { priority, round_robin };
+
+    queue_selector(std::vector<threadsafe_queue<T>*> queues_, policy order_ = policy::priority);
+    ~queue_selector();
+
+    queue_selector(const queue_selector& other) = delete;
+    queue_selector& operator=(const queue_selector& other) = delete;
+
+    bool try_pop_any(T& value, std::size_t& index);
+    std::size_t wait_any(T& value);
+    template<typename Rep, typename Period>
+    bool wait_any_for(T& value, std::size_t& index, std::chrono::duration<Rep, Period> const& timeout);
+
+private:
+    std::vector<threadsafe_queue<T>*> queues;
+    policy order;
+    std::size_t next_start;
+    queue_select_waiter waiter;
 };
 
 
@@ -65,6 +144,35 @@ void threadsafe_queue<T>::push(T new_value) {
     }
     
     data_cond.notify_one();
+
+    if (waiter_count.load() != 0)
+        notify_waiters();
+}
+
+template<typename T>
+void threadsafe_queue<T>::attach_waiter(queue_select_waiter* waiter) {
+    std::lock_guard<std::mutex> waiters_lock(waiters_mutex);
+    waiters.push_back(waiter);
+    waiter_count.fetch_add(1);
+}
+
+template<typename T>
+void threadsafe_queue<T>::detach_waiter(queue_select_waiter* waiter) {
+    std::lock_guard<std::mutex> waiters_lock(waiters_mutex);
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+    waiter_count.fetch_sub(1);
+}
+
+template<typename T>
+void threadsafe_queue<T>::notify_waiters() {
+    std::lock_guard<std::mutex> waiters_lock(waiters_mutex);
+    for (queue_select_waiter* waiter : waiters) {
+        {
+            std::lock_guard<std::mutex> lock(waiter->m);
+            ++waiter->signals;
+        }
+        waiter->cond.notify_one();
+    }
 }
 
 template<typename T>
@@ -150,9 +258,137 @@ std::unique_ptr<typename threadsafe_queue<T>::node> threadsafe_queue<T>::try_pop
    return pop_head();
 }
 
+// Detaches up to max_items nodes from the front in one go; the caller must
+// hold head_mutex. tail is sampled once, so the tail lock is taken once per
+// batch rather than once per element.
+template<typename T>
+std::unique_ptr<typename threadsafe_queue<T>::node> threadsafe_queue<T>::pop_head_batch(std::size_t max_items, std::size_t& count) {
+    node* const current_tail = get_tail();
+    count = 0;
+    if (max_items == 0 || head.get() == current_tail)
+        return nullptr;
+
+    node* last = head.get();
+    count = 1;
+    while (count < max_items && last->next.get() != current_tail) {
+        last = last->next.get();
+        ++count;
+    }
+
+    std::unique_ptr<node> batch = std::move(head);
+    head = std::move(last->next);
+    return batch;
+}
+
+template<typename T>
+void threadsafe_queue<T>::append_batch(std::unique_ptr<node> batch, std::vector<T>& out) {
+    while (batch) {
+        out.push_back(std::move(*batch->data));
+        batch = std::move(batch->next);
+    }
+}
+
+// Blocks for the first element, then keeps collecting until max_items have
+// been gathered or linger has passed since the first one arrived. Elements
+// are moved out after head_mutex is released.
+template<typename T>
+template<typename Rep, typename Period>
+std::size_t threadsafe_queue<T>::wait_pop_batch(std::vector<T>& out, std::size_t max_items, std::chrono::duration<Rep, Period> const& linger) {
+    if (max_items == 0)
+        return 0;
+
+    std::unique_lock<std::mutex> head_lock(wait_for_data());
+    auto const deadline = std::chrono::steady_clock::now() + linger;
+    std::size_t total = 0;
+
+    for (;;) {
+        std::size_t count;
+        std::unique_ptr<node> batch = pop_head_batch(max_items - total, count);
+        total += count;
+        head_lock.unlock();
+        append_batch(std::move(batch), out);
+
+        if (total >= max_items)
+            return total;
+
+        head_lock.lock();
+        if (!data_cond.wait_until(head_lock, deadline, [&] { return head.get() != get_tail(); }))
+            return total;
+    }
+}
+
+template<typename T>
+queue_selector<T>::queue_selector(std::vector<threadsafe_queue<T>*> queues_, policy order_) :
+    queues(std::move(queues_)), order(order_), next_start(0) {
+    for (threadsafe_queue<T>* q : queues)
+        q->attach_waiter(&waiter);
+}
+
+template<typename T>
+queue_selector<T>::~queue_selector() {
+    for (threadsafe_queue<T>* q : queues)
+        q->detach_waiter(&waiter);
+}
+
+template<typename T>
+bool queue_selector<T>::try_pop_any(T& value, std::size_t& index) {
+    std::size_t const count = queues.size();
+    std::size_t const start = (order == policy::round_robin) ? next_start : 0;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t const candidate = (start + i) % count;
+        if (queues[candidate]->try_pop(value)) {
+            index = candidate;
+            next_start = (candidate + 1) % count;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+std::size_t queue_selector<T>::wait_any(T& value) {
+    std::size_t index = 0;
+    for (;;) {
+        unsigned long seen;
+        {
+            std::lock_guard<std::mutex> lock(waiter.m);
+            seen = waiter.signals;
+        }
+
+        if (try_pop_any(value, index))
+            return index;
+
+        std::unique_lock<std::mutex> lock(waiter.m);
+        waiter.cond.wait(lock, [&] { return waiter.signals != seen; });
+    }
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+bool queue_selector<T>::wait_any_for(T& value, std::size_t& index, std::chrono::duration<Rep, Period> const& timeout) {
+    auto const deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        unsigned long seen;
+        {
+            std::lock_guard<std::mutex> lock(waiter.m);
+            seen = waiter.signals;
+        }
+
+        if (try_pop_any(value, index))
+            return true;
+
+        std::unique_lock<std::mutex> lock(waiter.m);
+        if (!waiter.cond.wait_until(lock, deadline, [&] { return waiter.signals != seen; }))
+            return false;
+    }
+}
+
 
 
 // testing
+// Define THREADSAFE_QUEUE_NO_TESTS to include this file for the class alone.
+#ifndef THREADSAFE_QUEUE_NO_TESTS
 
 // Test concurrent operations
 // Test concurrent operations with multiple producers and consumers
@@ -252,9 +488,163 @@ void test_sequential_operations() {
     std::cout << std::endl;
 }
 
-int main() {
+// Test selecting over several queues
+void test_select_operations() {
+    threadsafe_queue<int> control;
+    threadsafe_queue<int> data;
+    const int num_control = 5;
+    const int num_data = 50;
+
+    // With priority ordering every pending control item comes out first
+    for (int i = 0; i < num_data; ++i) {
+        data.push(1000 + i);
+    }
+    for (int i = 0; i < num_control; ++i) {
+        control.push(i);
+    }
+
+    bool priority_ok = true;
+    {
+        queue_selector<int> selector({&control, &data});
+        for (int i = 0; i < num_control + num_data; ++i) {
+            int item;
+            std::size_t index = selector.wait_any(item);
+            if ((i < num_control) != (index == 0)) {
+                priority_ok = false;
+            }
+        }
+    }
+
+    // Blocked selector is woken by producers pushing into either queue
+    std::unordered_set<int> results;
+    {
+        queue_selector<int> selector({&control, &data}, queue_selector<int>::policy::round_robin);
+        std::thread consumer([&] {
+            for (int i = 0; i < num_control + num_data; ++i) {
+                int item;
+                selector.wait_any(item);
+                results.insert(item);
+            }
+        });
+        std::thread producer([&] {
+            for (int i = 0; i < num_data; ++i) {
+                data.push(1000 + i);
+                if (i % 10 == 0) {
+                    control.push(i / 10);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        producer.join();
+        consumer.join();
+
+        int item;
+        std::size_t index;
+        if (selector.wait_any_for(item, index, std::chrono::milliseconds(10))) {
+            priority_ok = false;
+        }
+    }
+
+    if (priority_ok && results.size() == num_control + num_data) {
+        std::cout << "Select returned every value in priority order." << std::endl;
+    } else {
+        std::cout << "Select lost values or ignored priority." << std::endl;
+    }
+}
+
+// Test batch popping with a count limit and a linger deadline
+void test_batch_operations() {
+    threadsafe_queue<int> queue;
+    std::vector<int> results;
+    bool correct = true;
+
+    // Count limit: only max_items come out even though more are queued
+    for (int i = 0; i < 25; ++i) {
+        queue.push(i);
+    }
+    correct = correct && queue.wait_pop_batch(results, 10, std::chrono::milliseconds(100)) == 10;
+
+    // Linger: returns what is there once the deadline passes
+    auto const start = std::chrono::steady_clock::now();
+    correct = correct && queue.wait_pop_batch(results, 100, std::chrono::milliseconds(20)) == 15;
+    correct = correct && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20);
+
+    // Elements arriving during the linger window join the batch
+    std::thread producer([&] {
+        for (int i = 25; i < 35; ++i) {
+            queue.push(i);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    std::size_t collected = 0;
+    while (collected < 10) {
+        collected += queue.wait_pop_batch(results, 100, std::chrono::milliseconds(50));
+    }
+    producer.join();
+
+    for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+        if (results[i] != i) {
+            correct = false;
+        }
+    }
+
+    if (correct && results.size() == 35 && queue.empty()) {
+        std::cout << "Batch Results correct." << std::endl;
+    } else {
+        std::cout << "Batch Results wrong." << std::endl;
+    }
+}
+
+// benchmarking
+
+// Pushes and pops per second with num_threads producers and as many
+// consumers on one queue. Compare a default build with one built with
+// -DTHREADSAFE_QUEUE_UNPADDED, and run both under `perf c2c record` to see
+// the HITM traffic on the head/tail lines that the padding removes.
+void benchmark_false_sharing(int num_threads, int items_per_producer) {
+    threadsafe_queue<int> queue;
+    std::vector<std::thread> threads;
+
+    auto const start = std::chrono::steady_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < items_per_producer; ++i) {
+                queue.push(i);
+            }
+        });
+        threads.emplace_back([&] {
+            for (int i = 0; i < items_per_producer; ++i) {
+                int item;
+                queue.wait_and_pop(item);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#ifdef THREADSAFE_QUEUE_UNPADDED
+    char const* layout = "packed";
+#else
+    char const* layout = "padded";
+#endif
+    std::cout << layout << " layout, " << num_threads << "P/" << num_threads << "C: "
+              << num_threads * static_cast<double>(items_per_producer) / seconds / 1e6
+              << " M items/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
     test_concurrent_operations();
     test_sequential_operations();
-    
+    test_select_operations();
+    test_batch_operations();
+
+    int const items = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    benchmark_false_sharing(1, items);
+    benchmark_false_sharing(8, items / 8);
+
     return 0;
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,309 @@
+#include<memory>
+#include<mutex>
+#include<new>
+#include<type_traits>
+#include<vector>
+#include<string>
+#include<thread>
+#include<iostream>
+#include<cassert>
+#include<stdexcept>
+
+// Unrolled variant of threadsafe_list: each node stores up to NodeCapacity
+// elements inline under a single mutex. Traversals lock once per node rather
+// than once per element, and small payloads no longer pay for a mutex, a
+// shared_ptr and a next pointer each. Because elements live inside the node,
+// find_first_if returns a copy rather than a shared reference. push_front
+// only fills the first node, so remove_if keeps the chain dense by merging
+// neighbours whose elements fit in a single node.
+template<typename T, std::size_t NodeCapacity = 32>
+class unrolled_list{
+    static_assert(NodeCapacity>0, "nodes must hold at least one element");
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "remove_if compacts nodes by moving elements, which must not throw");
+
+private:
+    struct node{
+        std::mutex m;
+        std::size_t count;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type items[NodeCapacity];
+        std::unique_ptr<node> next;
+
+        node(): count(0) {}
+        ~node(){
+            for(std::size_t i=0;i<count;++i)
+                item(i).~T();
+        }
+
+        // Elements are stored oldest first, so push_front appends and list
+        // order is items[count-1] .. items[0].
+        T& item(std::size_t i){
+            return *std::launder(reinterpret_cast<T*>(&items[i]));
+        }
+    };
+
+    // Compacts one node for remove_if. Elements before next have been
+    // visited and the survivors among them moved into [0, kept). If the
+    // predicate throws, the destructor still moves the unvisited tail down
+    // and sets count, so the node never holds destroyed slots.
+    struct compaction{
+        node& n;
+        std::size_t kept;
+        std::size_t next;
+
+        explicit compaction(node& n_): n(n_), kept(0), next(0) {}
+        ~compaction(){
+            for(;next<n.count;++next)
+                keep(next);
+            n.count=kept;
+        }
+
+        void keep(std::size_t i){
+            if(kept!=i){
+                new (&n.items[kept]) T(std::move(n.item(i)));
+                n.item(i).~T();
+            }
+            ++kept;
+        }
+    };
+
+    node head;
+
+    // Moves every element of later, the node after front, into front. Its
+    // elements are older, so they go underneath front's own. Needs both
+    // nodes locked and their combined count to fit in one node.
+    static void absorb(node& front, node& later){
+        for(std::size_t i=front.count;i>0;--i){
+            new (&front.items[i-1+later.count]) T(std::move(front.item(i-1)));
+            front.item(i-1).~T();
+        }
+        for(std::size_t i=0;i<later.count;++i){
+            new (&front.items[i]) T(std::move(later.item(i)));
+            later.item(i).~T();
+        }
+        front.count+=later.count;
+        later.count=0;
+    }
+
+    template<typename Function>
+    static void visit_node(node& n, Function& f){
+        for(std::size_t i=n.count;i>0;--i)
+            f(n.item(i-1));
+    }
+
+public:
+    unrolled_list(){}
+    ~unrolled_list(){
+        // Unlink one node at a time so long chains do not recurse.
+        while(head.next)
+            head.next=std::move(head.next->next);
+    }
+
+    unrolled_list(unrolled_list const& other)=delete;
+    unrolled_list& operator=(unrolled_list const& other)=delete;
+
+    // Number of nodes currently in the chain.
+    std::size_t node_count(){
+        std::size_t nodes=0;
+        node* current=&head;
+        std::unique_lock<std::mutex> lk(head.m);
+        while(node* const next=current->next.get()){
+            std::unique_lock<std::mutex> next_lk(next->m);
+            lk.unlock();
+            ++nodes;
+            current=next;
+            lk=std::move(next_lk);
+        }
+        return nodes;
+    }
+
+    void push_front(T const& value){
+        std::unique_ptr<node> new_node;
+        std::unique_lock<std::mutex> lk(head.m);
+        if(node* const first=head.next.get()){
+            std::lock_guard<std::mutex> first_lk(first->m);
+            if(first->count<NodeCapacity){
+                new (&first->items[first->count]) T(value);
+                ++first->count;
+                return;
+            }
+        }
+        lk.unlock();
+
+        new_node.reset(new node);
+        new (&new_node->items[0]) T(value);
+        new_node->count=1;
+
+        lk.lock();
+        new_node->next=std::move(head.next);
+        head.next=std::move(new_node);
+    }
+
+    template<typename Function>
+    void for_each(Function f){
+        node* current=&head;
+        std::unique_lock<std::mutex> lk(head.m);
+        while(node* const next=current->next.get()){
+            std::unique_lock<std::mutex> next_lk(next->m);
+            lk.unlock();
+            visit_node(*next, f);
+            current=next;
+            lk=std::move(next_lk);
+        }
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_if(Predicate p){
+        node* current=&head;
+        std::unique_lock<std::mutex> lk(head.m);
+        while(node* const next=current->next.get()){
+            std::unique_lock<std::mutex> next_lk(next->m);
+            lk.unlock();
+            for(std::size_t i=next->count;i>0;--i){
+                if(p(next->item(i-1)))
+                    return std::make_shared<T>(next->item(i-1));
+            }
+            current=next;
+            lk=std::move(next_lk);
+        }
+        return std::shared_ptr<T>();
+    }
+
+    template<typename Predicate>
+    void remove_if(Predicate p){
+        node* current=&head;
+        std::unique_lock<std::mutex> lk(head.m);
+        while(node* const next=current->next.get())
+        {
+            std::unique_lock<std::mutex> next_lk(next->m);
+
+            // Compact the survivors towards the front, keeping their order.
+            bool emptied;
+            {
+                compaction c(*next);
+                for(;c.next<next->count;++c.next){
+                    if(p(next->item(c.next)))
+                        next->item(c.next).~T();
+                    else
+                        c.keep(c.next);
+                }
+                emptied=c.kept==0;
+            }
+
+            // A node left sparse is merged into its predecessor, so heavy
+            // removal does not leave a chain of nearly empty nodes.
+            if(!emptied && current!=&head && current->count+next->count<=NodeCapacity)
+            {
+                absorb(*current, *next);
+                emptied=true;
+            }
+
+            if(emptied)
+            {
+                std::unique_ptr<node> old_next=std::move(current->next);
+                current->next=std::move(next->next);
+                next_lk.unlock();
+            }
+            else
+            {
+                lk.unlock();
+                current=next;
+                lk=std::move(next_lk);
+            }
+        }
+    }
+};
+
+// testing
+
+void test_sequential_operations(){
+    unrolled_list<int, 4> list;
+    for(int i=0;i<10;++i)
+        list.push_front(i);
+
+    std::vector<int> order;
+    list.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{9,8,7,6,5,4,3,2,1,0}));
+
+    std::shared_ptr<int> found=list.find_first_if([](int const& v){return v<5;});
+    assert(found && *found==4);
+
+    list.remove_if([](int const& v){return v%3!=0;});
+    order.clear();
+    list.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{9,6,3,0}));
+
+    list.remove_if([](int const&){return true;});
+    assert(!list.find_first_if([](int const&){return true;}));
+
+    // Sparse nodes left by a removal pass are merged back together
+    unrolled_list<int, 8> sparse;
+    for(int i=0;i<64;++i)
+        sparse.push_front(i);
+    assert(sparse.node_count()==8);
+    sparse.remove_if([](int const& v){return v%8!=0;});
+    assert(sparse.node_count()==1);
+    order.clear();
+    sparse.for_each([&](int& v){order.push_back(v);});
+    assert((order==std::vector<int>{56,48,40,32,24,16,8,0}));
+
+    // A throwing predicate leaves every unvisited element in place
+    unrolled_list<std::string, 8> strings;
+    for(int i=0;i<6;++i)
+        strings.push_front(std::to_string(i));
+    bool thrown=false;
+    try{
+        strings.remove_if([](std::string const& s){
+            if(s=="3")
+                throw std::runtime_error("boom");
+            return s=="1";
+        });
+    }catch(std::runtime_error const&){
+        thrown=true;
+    }
+    assert(thrown);
+    std::vector<std::string> left;
+    strings.for_each([&](std::string& s){left.push_back(s);});
+    assert((left==std::vector<std::string>{"5","4","3","2","0"}));
+}
+
+void test_concurrent_operations(){
+    unrolled_list<std::string, 16> list;
+    const int num_threads=4;
+    const int items_per_thread=3000;
+    std::vector<std::thread> threads;
+
+    for(int t=0;t<num_threads;++t){
+        threads.emplace_back([&,t]{
+            for(int i=0;i<items_per_thread;++i){
+                list.push_front(std::to_string(t*items_per_thread+i));
+                if(i%100==99){
+                    list.remove_if([](std::string const& s){return s.back()=='7';});
+                }
+            }
+        });
+    }
+    threads.emplace_back([&]{
+        for(int i=0;i<50;++i){
+            list.for_each([](std::string& s){assert(!s.empty());});
+        }
+    });
+    for(auto& thread:threads)
+        thread.join();
+
+    list.remove_if([](std::string const& s){return s.back()=='7';});
+    int count=0;
+    list.for_each([&](std::string& s){
+        assert(s.back()!='7');
+        ++count;
+    });
+    assert(count==num_threads*items_per_thread/10*9);
+}
+
+int main(){
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout<<"All tests passed!"<<std::endl;
+
+    return 0;
+}
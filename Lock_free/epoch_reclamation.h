@@ -0,0 +1,155 @@
+#ifndef EPOCH_RECLAMATION_H
+#define EPOCH_RECLAMATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Epoch-based memory reclamation shared by the lock-free structures.
+//
+// A thread reading shared nodes holds an epoch_guard. Unlinked nodes are
+// handed to retire() and freed only after the global epoch has moved twice
+// past the epoch they were retired in. Every thread that could still see a
+// node must have left its critical section by then. Guards nest, and
+// records of exited threads are reused by later threads.
+class epoch_domain {
+private:
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t collect_interval = 64;
+
+    struct retired_node {
+        void* pointer;
+        void (*deleter)(void*);
+        std::uint64_t epoch;
+    };
+
+    struct alignas(cache_line_size) thread_record {
+        // (epoch << 1) | 1 while inside a critical section, 0 otherwise.
+        std::atomic<std::uint64_t> state{0};
+        std::atomic<bool> in_use{true};
+        unsigned nesting = 0;
+        std::size_t retires_since_collect = 0;
+        std::vector<retired_node> limbo;
+        thread_record* next = nullptr;
+    };
+
+    struct record_holder {
+        thread_record* record = nullptr;
+
+        ~record_holder() {
+            if (record)
+                record->in_use.store(false);
+        }
+    };
+
+    std::atomic<std::uint64_t> global_epoch{0};
+    std::atomic<thread_record*> records{nullptr};
+
+    epoch_domain() = default;
+
+    thread_record* acquire_record() {
+        for (thread_record* r = records.load(); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true))
+                return r;
+        }
+
+        thread_record* const r = new thread_record;
+        thread_record* head = records.load();
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r));
+        return r;
+    }
+
+    thread_record* local_record() {
+        thread_local record_holder holder;
+        if (!holder.record)
+            holder.record = acquire_record();
+        return holder.record;
+    }
+
+    // Moves the epoch on if every active thread has caught up with it.
+    bool try_advance() {
+        std::uint64_t current = global_epoch.load();
+        for (thread_record* r = records.load(); r; r = r->next) {
+            std::uint64_t const s = r->state.load();
+            if ((s & 1) && (s >> 1) != current)
+                return false;
+        }
+        return global_epoch.compare_exchange_strong(current, current + 1);
+    }
+
+    static void free_before(thread_record* r, std::uint64_t safe_epoch) {
+        auto const first_kept = std::partition(r->limbo.begin(), r->limbo.end(),
+            [&](retired_node const& n) { return n.epoch + 2 <= safe_epoch; });
+        for (auto it = r->limbo.begin(); it != first_kept; ++it)
+            it->deleter(it->pointer);
+        r->limbo.erase(r->limbo.begin(), first_kept);
+    }
+
+public:
+    ~epoch_domain() {
+        thread_record* r = records.load();
+        while (r) {
+            for (retired_node const& n : r->limbo)
+                n.deleter(n.pointer);
+            thread_record* const next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+    epoch_domain(epoch_domain const& other) = delete;
+    epoch_domain& operator=(epoch_domain const& other) = delete;
+
+    static epoch_domain& instance() {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    void enter() {
+        thread_record* const r = local_record();
+        if (r->nesting++ == 0)
+            r->state.store((global_epoch.load() << 1) | 1);
+    }
+
+    void exit() {
+        thread_record* const r = local_record();
+        if (--r->nesting == 0)
+            r->state.store(0);
+    }
+
+    void retire(void* pointer, void (*deleter)(void*)) {
+        thread_record* const r = local_record();
+        r->limbo.push_back(retired_node{pointer, deleter, global_epoch.load()});
+        if (++r->retires_since_collect >= collect_interval) {
+            r->retires_since_collect = 0;
+            try_advance();
+            free_before(r, global_epoch.load());
+        }
+    }
+
+    template<typename T>
+    void retire(T* pointer) {
+        retire(pointer, [](void* p) { delete static_cast<T*>(p); });
+    }
+};
+
+class epoch_guard {
+public:
+    epoch_guard() {
+        epoch_domain::instance().enter();
+    }
+
+    ~epoch_guard() {
+        epoch_domain::instance().exit();
+    }
+
+    epoch_guard(epoch_guard const& other) = delete;
+    epoch_guard& operator=(epoch_guard const& other) = delete;
+};
+
+#endif
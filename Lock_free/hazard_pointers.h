@@ -0,0 +1,141 @@
+#ifndef HAZARD_POINTERS_H
+#define HAZARD_POINTERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Hazard-pointer memory reclamation for the lock-free structures.
+//
+// Before dereferencing a shared node a thread publishes it in one of its
+// hazard slots and then re-validates that the node is still reachable.
+// Retired nodes are freed by a periodic scan, except for those that some
+// thread currently publishes. Unlike epoch_domain, one stalled reader only
+// pins the few nodes it protects.
+class hazard_domain {
+public:
+    static constexpr std::size_t slots_per_thread = 3;
+
+private:
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t scan_threshold = 64;
+
+    struct retired_node {
+        void* pointer;
+        void (*deleter)(void*);
+    };
+
+public:
+    class alignas(cache_line_size) thread_hazards {
+    public:
+        void protect(std::size_t index, void const* pointer) {
+            slots[index].store(const_cast<void*>(pointer));
+        }
+
+        void clear() {
+            for (std::atomic<void*>& slot : slots)
+                slot.store(nullptr, std::memory_order_release);
+        }
+
+    private:
+        friend class hazard_domain;
+
+        std::atomic<void*> slots[slots_per_thread] = {};
+        std::atomic<bool> in_use{true};
+        std::vector<retired_node> retired;
+        thread_hazards* next = nullptr;
+    };
+
+private:
+    struct record_holder {
+        thread_hazards* record = nullptr;
+
+        ~record_holder() {
+            if (record) {
+                record->clear();
+                record->in_use.store(false);
+            }
+        }
+    };
+
+    std::atomic<thread_hazards*> records{nullptr};
+
+    hazard_domain() = default;
+
+    thread_hazards* acquire_record() {
+        for (thread_hazards* r = records.load(); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true))
+                return r;
+        }
+
+        thread_hazards* const r = new thread_hazards;
+        thread_hazards* head = records.load();
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r));
+        return r;
+    }
+
+    void scan(thread_hazards* own) {
+        std::vector<void*> hazards;
+        for (thread_hazards* r = records.load(); r; r = r->next) {
+            for (std::atomic<void*> const& slot : r->slots) {
+                if (void* const p = slot.load())
+                    hazards.push_back(p);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        std::vector<retired_node> still_hazardous;
+        for (retired_node const& n : own->retired) {
+            if (std::binary_search(hazards.begin(), hazards.end(), n.pointer))
+                still_hazardous.push_back(n);
+            else
+                n.deleter(n.pointer);
+        }
+        own->retired.swap(still_hazardous);
+    }
+
+public:
+    ~hazard_domain() {
+        thread_hazards* r = records.load();
+        while (r) {
+            for (retired_node const& n : r->retired)
+                n.deleter(n.pointer);
+            thread_hazards* const next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+    hazard_domain(hazard_domain const& other) = delete;
+    hazard_domain& operator=(hazard_domain const& other) = delete;
+
+    static hazard_domain& instance() {
+        static hazard_domain domain;
+        return domain;
+    }
+
+    thread_hazards& local() {
+        thread_local record_holder holder;
+        if (!holder.record)
+            holder.record = acquire_record();
+        return *holder.record;
+    }
+
+    void retire(void* pointer, void (*deleter)(void*)) {
+        thread_hazards& own = local();
+        own.retired.push_back(retired_node{pointer, deleter});
+        if (own.retired.size() >= scan_threshold)
+            scan(&own);
+    }
+
+    template<typename T>
+    void retire(T* pointer) {
+        retire(pointer, [](void* p) { delete static_cast<T*>(p); });
+    }
+};
+
+#endif
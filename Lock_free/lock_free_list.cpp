@@ -0,0 +1,281 @@
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "hazard_pointers.h"
+
+// Lock-free ordered list (Harris' marked-pointer deletion with Michael's
+// hazard-pointer safe traversal). A node is deleted logically by setting the
+// low bit of its next pointer, then unlinked by whichever thread passes it
+// next. No traversal takes a lock, so readers never block writers.
+// Values are kept sorted by Compare and are unique.
+template<typename T, typename Compare = std::less<T> >
+class lock_free_list {
+private:
+    struct node {
+        T const value;
+        std::atomic<std::uintptr_t> next;
+
+        explicit node(T const& value_) : value(value_), next(0) {}
+    };
+
+    typedef std::atomic<std::uintptr_t> link;
+
+    static bool is_marked(std::uintptr_t p) {
+        return (p & 1) != 0;
+    }
+
+    static node* pointer(std::uintptr_t p) {
+        return reinterpret_cast<node*>(p & ~std::uintptr_t(1));
+    }
+
+    static std::uintptr_t bits(node* p) {
+        return reinterpret_cast<std::uintptr_t>(p);
+    }
+
+    link head;
+    Compare less;
+
+    // Hazard slots: 0 protects next, 1 protects cur, 2 protects the node
+    // owning prev_link.
+    struct position {
+        link* prev_link;
+        node* cur;
+        node* next;
+    };
+
+    // Walks to the first unmarked node for which stop(value) holds, unlinking
+    // marked nodes on the way. On return pos.cur (null at the end of the
+    // list) and the node owning pos.prev_link are protected.
+    template<typename Stop>
+    void search(Stop stop, position& pos, hazard_domain::thread_hazards& hp) {
+    try_again:
+        pos.prev_link = &head;
+        pos.cur = pointer(pos.prev_link->load());
+        hp.protect(1, pos.cur);
+        if (pos.prev_link->load() != bits(pos.cur))
+            goto try_again;
+
+        for (;;) {
+            if (!pos.cur)
+                return;
+
+            std::uintptr_t const n = pos.cur->next.load();
+            pos.next = pointer(n);
+            hp.protect(0, pos.next);
+            if (pos.cur->next.load() != n)
+                goto try_again;
+            if (pos.prev_link->load() != bits(pos.cur))
+                goto try_again;
+
+            if (!is_marked(n)) {
+                if (stop(pos.cur->value))
+                    return;
+                pos.prev_link = &pos.cur->next;
+                hp.protect(2, pos.cur);
+            } else {
+                std::uintptr_t expected = bits(pos.cur);
+                if (!pos.prev_link->compare_exchange_strong(expected, bits(pos.next)))
+                    goto try_again;
+                hazard_domain::instance().retire(pos.cur);
+            }
+            pos.cur = pos.next;
+            hp.protect(1, pos.next);
+        }
+    }
+
+    bool find(T const& value, position& pos, hazard_domain::thread_hazards& hp) {
+        search([&](T const& v) { return !less(v, value); }, pos, hp);
+        return pos.cur && !less(value, pos.cur->value);
+    }
+
+public:
+    lock_free_list() : head(0) {}
+
+    ~lock_free_list() {
+        node* current = pointer(head.load());
+        while (current) {
+            node* const next = pointer(current->next.load());
+            delete current;
+            current = next;
+        }
+    }
+
+    lock_free_list(lock_free_list const& other) = delete;
+    lock_free_list& operator=(lock_free_list const& other) = delete;
+
+    bool insert(T const& value) {
+        hazard_domain::thread_hazards& hp = hazard_domain::instance().local();
+        std::unique_ptr<node> new_node(new node(value));
+        position pos;
+        for (;;) {
+            if (find(value, pos, hp)) {
+                hp.clear();
+                return false;
+            }
+            new_node->next.store(bits(pos.cur));
+            std::uintptr_t expected = bits(pos.cur);
+            if (pos.prev_link->compare_exchange_strong(expected, bits(new_node.get()))) {
+                new_node.release();
+                hp.clear();
+                return true;
+            }
+        }
+    }
+
+    bool erase(T const& value) {
+        hazard_domain::thread_hazards& hp = hazard_domain::instance().local();
+        position pos;
+        for (;;) {
+            if (!find(value, pos, hp)) {
+                hp.clear();
+                return false;
+            }
+            std::uintptr_t expected = bits(pos.next);
+            if (!pos.cur->next.compare_exchange_strong(expected, bits(pos.next) | 1))
+                continue;
+
+            expected = bits(pos.cur);
+            if (pos.prev_link->compare_exchange_strong(expected, bits(pos.next)))
+                hazard_domain::instance().retire(pos.cur);
+            else
+                find(value, pos, hp);
+            hp.clear();
+            return true;
+        }
+    }
+
+    bool contains(T const& value) {
+        hazard_domain::thread_hazards& hp = hazard_domain::instance().local();
+        position pos;
+        bool const found = find(value, pos, hp);
+        hp.clear();
+        return found;
+    }
+
+    template<typename Predicate>
+    std::shared_ptr<T> find_first_if(Predicate p) {
+        hazard_domain::thread_hazards& hp = hazard_domain::instance().local();
+        position pos;
+        search(p, pos, hp);
+        std::shared_ptr<T> res = pos.cur ? std::make_shared<T>(pos.cur->value) : std::shared_ptr<T>();
+        hp.clear();
+        return res;
+    }
+
+    // Not linearizable as a whole: values inserted or erased during the walk
+    // may or may not be seen. A walk that has to restart from the head skips
+    // everything up to the last value already visited, so f sees each value
+    // at most once and in order.
+    template<typename Function>
+    void for_each(Function f) {
+        hazard_domain::thread_hazards& hp = hazard_domain::instance().local();
+        position pos;
+        std::optional<T> last;
+        search([&](T const& v) {
+            if (!last || less(*last, v)) {
+                f(v);
+                last = v;
+            }
+            return false;
+        }, pos, hp);
+        hp.clear();
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    lock_free_list<int> list;
+    for (int v : {5, 1, 9, 3, 7, 3}) {
+        list.insert(v);
+    }
+
+    std::vector<int> values;
+    list.for_each([&](int const& v) { values.push_back(v); });
+    assert((values == std::vector<int>{1, 3, 5, 7, 9}));
+
+    assert(list.contains(7));
+    bool const reinserted = list.insert(7);
+    assert(!reinserted);
+    bool const erased = list.erase(7);
+    assert(erased);
+    bool const erased_again = list.erase(7);
+    assert(!erased_again);
+    assert(!list.contains(7));
+
+    std::shared_ptr<int> found = list.find_first_if([](int const& v) { return v > 4; });
+    assert(found && *found == 5);
+    assert(!list.find_first_if([](int const& v) { return v > 100; }));
+}
+
+void test_concurrent_operations() {
+    lock_free_list<int> list;
+    const int num_threads = 4;
+    const int range = 2000;
+    std::vector<std::thread> threads;
+
+    // Each thread owns the keys congruent to its id; readers run alongside
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 3; ++round) {
+                for (int k = t; k < range; k += num_threads) {
+                    bool const inserted = list.insert(k);
+                    assert(inserted);
+                }
+                for (int k = t; k < range; k += num_threads) {
+                    if (k % 3 != 0 || round == 2) {
+                        bool const erased = list.erase(k);
+                        assert(erased);
+                    }
+                }
+                for (int k = t; k < range; k += num_threads) {
+                    if (k % 3 == 0 && round != 2) {
+                        bool const erased = list.erase(k);
+                        assert(erased);
+                    }
+                }
+            }
+            for (int k = t; k < range; k += num_threads) {
+                if (k % 2 == 0) {
+                    list.insert(k);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        for (int i = 0; i < 200; ++i) {
+            int previous = -1;
+            list.for_each([&](int const& v) {
+                assert(v > previous);
+                previous = v;
+            });
+            list.contains(i);
+        }
+    });
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<int> values;
+    list.for_each([&](int const& v) { values.push_back(v); });
+    assert(static_cast<int>(values.size()) == range / 2);
+    for (int i = 0; i < static_cast<int>(values.size()); ++i) {
+        assert(values[i] == 2 * i);
+    }
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+    std::cout << "All tests passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "epoch_reclamation.h"
+
+#define THREADSAFE_QUEUE_NO_TESTS
+#include "../Lock_based/threadsafe_queue.cpp"
+
+// Unbounded Michael-Scott queue. Producers and consumers each need a single
+// CAS on the shared tail / head instead of a mutex, and popped dummy nodes
+// are reclaimed through epoch_domain. The public interface matches
+// threadsafe_queue; wait_and_pop parks on a condition variable only after
+// the queue has been seen empty, so uncontended pushes never touch the mutex.
+template<typename T>
+class lock_free_queue {
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct node {
+        std::shared_ptr<T> data;
+        std::atomic<node*> next;
+
+        node() : next(nullptr) {}
+    };
+
+    alignas(cache_line_size) std::atomic<node*> head;
+    alignas(cache_line_size) std::atomic<node*> tail;
+
+    alignas(cache_line_size) std::atomic<std::size_t> waiters;
+    std::mutex wait_mutex;
+    std::condition_variable data_cond;
+
+    std::shared_ptr<T> pop_head() {
+        epoch_guard guard;
+        for (;;) {
+            node* const old_head = head.load();
+            node* old_tail = tail.load();
+            node* const next = old_head->next.load();
+            if (old_head != head.load())
+                continue;
+
+            if (old_head == old_tail) {
+                if (!next)
+                    return std::shared_ptr<T>();
+                tail.compare_exchange_strong(old_tail, next);
+                continue;
+            }
+
+            node* expected = old_head;
+            if (head.compare_exchange_strong(expected, next)) {
+                // next is the new dummy; only the winner of the CAS touches its data.
+                std::shared_ptr<T> res = std::move(next->data);
+                epoch_domain::instance().retire(old_head);
+                return res;
+            }
+        }
+    }
+
+public:
+    lock_free_queue() : head(new node), tail(head.load()), waiters(0) {}
+
+    ~lock_free_queue() {
+        node* current = head.load();
+        while (current) {
+            node* const next = current->next.load();
+            delete current;
+            current = next;
+        }
+    }
+
+    lock_free_queue(const lock_free_queue& other) = delete;
+    lock_free_queue& operator=(const lock_free_queue& other) = delete;
+
+    void push(T new_value) {
+        node* const new_node = new node;
+        new_node->data = std::make_shared<T>(std::move(new_value));
+
+        {
+            epoch_guard guard;
+            for (;;) {
+                node* old_tail = tail.load();
+                node* next = old_tail->next.load();
+                if (old_tail != tail.load())
+                    continue;
+
+                if (next) {
+                    tail.compare_exchange_strong(old_tail, next);
+                    continue;
+                }
+
+                if (old_tail->next.compare_exchange_strong(next, new_node)) {
+                    tail.compare_exchange_strong(old_tail, new_node);
+                    break;
+                }
+            }
+        }
+
+        if (waiters.load() != 0) {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            data_cond.notify_one();
+        }
+    }
+
+    std::shared_ptr<T> try_pop() {
+        return pop_head();
+    }
+
+    bool try_pop(T& value) {
+        std::shared_ptr<T> const res = pop_head();
+        if (!res)
+            return false;
+        value = std::move(*res);
+        return true;
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::shared_ptr<T> res = pop_head();
+        if (res)
+            return res;
+
+        waiters.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            data_cond.wait(lock, [&] { return (res = pop_head()) != nullptr; });
+        }
+        waiters.fetch_sub(1);
+        return res;
+    }
+
+    void wait_and_pop(T& value) {
+        value = std::move(*wait_and_pop());
+    }
+
+    bool empty() {
+        epoch_guard guard;
+        return head.load()->next.load() == nullptr;
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    lock_free_queue<int> queue;
+    std::vector<int> results;
+
+    for (int i = 0; i < 10; ++i) {
+        queue.push(i);
+    }
+
+    while (!queue.empty()) {
+        int item;
+        if (queue.try_pop(item)) {
+            results.push_back(item);
+        }
+    }
+
+    std::cout << "Sequential Results: ";
+    for (const auto& item : results) {
+        std::cout << item << " ";
+    }
+    std::cout << std::endl;
+}
+
+void test_concurrent_operations() {
+    lock_free_queue<int> queue;
+    const int num_producers = 5;
+    const int num_consumers = 5;
+    const int items_per_producer = 20000;
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+    std::mutex results_mutex;
+    std::unordered_set<int> results;
+
+    for (int id = 0; id < num_producers; ++id) {
+        producers.emplace_back([&, id] {
+            for (int i = 0; i < items_per_producer; ++i) {
+                queue.push(id * items_per_producer + i);
+            }
+        });
+    }
+
+    for (int c = 0; c < num_consumers; ++c) {
+        consumers.emplace_back([&] {
+            std::vector<int> local;
+            for (int i = 0; i < num_producers * items_per_producer / num_consumers; ++i) {
+                int item;
+                queue.wait_and_pop(item);
+                local.push_back(item);
+            }
+            std::lock_guard<std::mutex> lock(results_mutex);
+            results.insert(local.begin(), local.end());
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    if (results.size() == num_producers * items_per_producer && queue.empty()) {
+        std::cout << "All values were produced and consumed correctly." << std::endl;
+    } else {
+        std::cout << "Some values were missing in the results." << std::endl;
+    }
+}
+
+// benchmarking
+
+// Pushes total_items through the queue with n producers and n consumers and
+// returns the elapsed wall time in seconds.
+template<typename Queue>
+double run_benchmark(int threads, int total_items) {
+    Queue queue;
+    int const per_thread = total_items / threads;
+    std::vector<std::thread> workers;
+    std::atomic<bool> go(false);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            while (!go.load())
+                std::this_thread::yield();
+            for (int i = 0; i < per_thread; ++i)
+                queue.push(i);
+        });
+        workers.emplace_back([&] {
+            while (!go.load())
+                std::this_thread::yield();
+            int item;
+            for (int i = 0; i < per_thread; ++i)
+                queue.wait_and_pop(item);
+        });
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto& w : workers) {
+        w.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_scaling(int total_items) {
+    std::cout << "threads  two-lock Mops/s  lock-free Mops/s" << std::endl;
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        int const items = total_items / threads * threads;
+        double const two_lock = run_benchmark<threadsafe_queue<int> >(threads, items);
+        double const lock_free = run_benchmark<lock_free_queue<int> >(threads, items);
+        std::cout << threads << "x" << threads << "\t " << items / two_lock / 1e6
+                  << "\t\t  " << items / lock_free / 1e6 << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    test_sequential_operations();
+    test_concurrent_operations();
+    benchmark_scaling(argc > 1 ? std::atoi(argv[1]) : 200000);
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Single-writer / multi-reader ring buffer in the style of the LMAX disruptor.
+// Every consumer sees every element: each one owns a sequence cursor, and the
+// producer may only reuse a slot once the slowest consumer has released it.
+// Slots are constructed once up front and overwritten in place, so fanning an
+// event out to N consumers costs one write instead of N queue pushes.
+template<typename T>
+class multicast_ring_buffer {
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct alignas(cache_line_size) padded_sequence {
+        std::atomic<std::int64_t> value;
+
+        explicit padded_sequence(std::int64_t initial) : value(initial) {}
+    };
+
+    std::vector<T> entries;
+    std::size_t const mask;
+
+    // Last published sequence, read by every consumer.
+    padded_sequence cursor;
+
+    // Producer-only state, kept off the cursor's cache line.
+    alignas(cache_line_size) std::int64_t next_sequence;
+    std::int64_t cached_gating;
+
+    std::vector<std::unique_ptr<padded_sequence>> consumers;
+
+    static void back_off(unsigned& spins) {
+        if (++spins < 100)
+            return;
+        std::this_thread::yield();
+    }
+
+    std::int64_t minimum_consumer_sequence() const {
+        std::int64_t minimum = cursor.value.load(std::memory_order_relaxed);
+        for (auto const& consumer : consumers) {
+            std::int64_t const seq = consumer->value.load(std::memory_order_acquire);
+            if (seq < minimum)
+                minimum = seq;
+        }
+        return minimum;
+    }
+
+public:
+    explicit multicast_ring_buffer(std::size_t capacity) :
+        entries(capacity), mask(capacity - 1), cursor(-1), next_sequence(0), cached_gating(-1) {
+        if (capacity == 0 || (capacity & mask) != 0)
+            throw std::invalid_argument("ring buffer capacity must be a power of two");
+    }
+
+    multicast_ring_buffer(multicast_ring_buffer const& other) = delete;
+    multicast_ring_buffer& operator=(multicast_ring_buffer const& other) = delete;
+
+    std::size_t capacity() const {
+        return entries.size();
+    }
+
+    // Consumers must all be registered before the producer claims anything.
+    std::size_t add_consumer() {
+        consumers.emplace_back(new padded_sequence(cursor.value.load()));
+        return consumers.size() - 1;
+    }
+
+    // Producer side: reserve n consecutive slots and return the first sequence.
+    // Blocks while any consumer is still reading the slots being reused.
+    std::int64_t claim(std::size_t n = 1) {
+        if (n == 0 || n > entries.size())
+            throw std::invalid_argument("claim size must be between 1 and capacity");
+
+        std::int64_t const first = next_sequence;
+        std::int64_t const last = first + static_cast<std::int64_t>(n) - 1;
+        std::int64_t const wrap_point = last - static_cast<std::int64_t>(entries.size());
+
+        unsigned spins = 0;
+        while (wrap_point > cached_gating) {
+            cached_gating = minimum_consumer_sequence();
+            if (wrap_point > cached_gating)
+                back_off(spins);
+        }
+
+        next_sequence = last + 1;
+        return first;
+    }
+
+    T& operator[](std::int64_t sequence) {
+        return entries[static_cast<std::size_t>(sequence) & mask];
+    }
+
+    T const& operator[](std::int64_t sequence) const {
+        return entries[static_cast<std::size_t>(sequence) & mask];
+    }
+
+    // Makes every claimed slot up to and including last visible to consumers.
+    void publish(std::int64_t last) {
+        cursor.value.store(last, std::memory_order_release);
+    }
+
+    void push(T value) {
+        std::int64_t const sequence = claim();
+        (*this)[sequence] = std::move(value);
+        publish(sequence);
+    }
+
+    // Consumer side: wait until sequence is published and return the highest
+    // published sequence, which lets the caller process a whole batch.
+    std::int64_t wait_for(std::int64_t sequence) const {
+        unsigned spins = 0;
+        std::int64_t available;
+        while ((available = cursor.value.load(std::memory_order_acquire)) < sequence)
+            back_off(spins);
+        return available;
+    }
+
+    std::int64_t next_for(std::size_t consumer) const {
+        return consumers[consumer]->value.load(std::memory_order_relaxed) + 1;
+    }
+
+    // Hands every slot up to and including last back to the producer.
+    void release(std::size_t consumer, std::int64_t last) {
+        consumers[consumer]->value.store(last, std::memory_order_release);
+    }
+
+    // Waits for at least one element, calls f on every element published so
+    // far (up to max_items), then releases the batch in one store.
+    template<typename Function>
+    std::size_t consume(std::size_t consumer, Function f, std::size_t max_items = SIZE_MAX) {
+        std::int64_t const first = next_for(consumer);
+        std::int64_t last = wait_for(first);
+        if (static_cast<std::uint64_t>(last - first) >= max_items)
+            last = first + static_cast<std::int64_t>(max_items) - 1;
+
+        for (std::int64_t seq = first; seq <= last; ++seq)
+            f((*this)[seq]);
+
+        release(consumer, last);
+        return static_cast<std::size_t>(last - first + 1);
+    }
+};
+
+// testing
+
+void test_sequential_operations() {
+    multicast_ring_buffer<int> ring(8);
+    std::size_t const a = ring.add_consumer();
+    std::size_t const b = ring.add_consumer();
+
+    // Batch claim and publish
+    std::int64_t const first = ring.claim(4);
+    for (int i = 0; i < 4; ++i) {
+        ring[first + i] = i;
+    }
+    ring.publish(first + 3);
+
+    std::vector<int> seen_a;
+    std::vector<int> seen_b;
+    ring.consume(a, [&](int v) { seen_a.push_back(v); });
+    ring.consume(b, [&](int v) { seen_b.push_back(v); }, 2);
+    ring.consume(b, [&](int v) { seen_b.push_back(v); });
+
+    bool correct = seen_a == std::vector<int>{0, 1, 2, 3} && seen_b == seen_a;
+
+    std::cout << (correct ? "Sequential batch claim/consume correct." : "Sequential batch claim/consume wrong.") << std::endl;
+}
+
+void test_concurrent_operations() {
+    const int num_consumers = 6;
+    const int num_items = 200000;
+    multicast_ring_buffer<int> ring(1024);
+
+    std::vector<std::size_t> ids;
+    for (int i = 0; i < num_consumers; ++i) {
+        ids.push_back(ring.add_consumer());
+    }
+
+    std::vector<long long> sums(num_consumers, 0);
+    std::vector<char> ordered(num_consumers, 1);
+    std::vector<std::thread> consumers;
+
+    for (int c = 0; c < num_consumers; ++c) {
+        consumers.emplace_back([&, c] {
+            int expected = 0;
+            while (expected < num_items) {
+                ring.consume(ids[c], [&](int v) {
+                    if (v != expected) {
+                        ordered[c] = 0;
+                    }
+                    sums[c] += v;
+                    ++expected;
+                });
+            }
+        });
+    }
+
+    // Producer alternates single pushes with batched claims
+    int next = 0;
+    while (next < num_items) {
+        if (next % 3 == 0) {
+            ring.push(next++);
+        } else {
+            int const batch = std::min(16, num_items - next);
+            std::int64_t const first = ring.claim(batch);
+            for (int i = 0; i < batch; ++i) {
+                ring[first + i] = next++;
+            }
+            ring.publish(first + batch - 1);
+        }
+    }
+
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    long long const expected_sum = static_cast<long long>(num_items) * (num_items - 1) / 2;
+    bool correct = true;
+    for (int c = 0; c < num_consumers; ++c) {
+        if (sums[c] != expected_sum || !ordered[c]) {
+            correct = false;
+        }
+    }
+
+    if (correct) {
+        std::cout << "Every consumer saw every value in order." << std::endl;
+    } else {
+        std::cout << "Some consumer missed or reordered values." << std::endl;
+    }
+}
+
+int main() {
+    test_sequential_operations();
+    test_concurrent_operations();
+
+    return 0;
+}